@@ -0,0 +1,40 @@
+/* A minimal strategy plugin: always guesses the first word which can
+ * still be the solution. Build with `make bot_example.so` and run with
+ * `./clidle -T -P ./bot_example.so`. */
+#include <string.h>
+
+#include "clidle_bot.h"
+
+/* Guesses are indices into words, candidates into solutions. This bot
+ * relies on the solutions being the first words of words.txt. */
+static int init(const struct clidle_bot_words *words)
+{
+    if (words->solutions_len > words->words_len)
+        return -1;
+
+    for (size_t i = 0; i < words->solutions_len; i++) {
+        if (memcmp(words->words[i], words->solutions[i], CLIDLE_BOT_LETTERS) != 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+static void guess(const struct clidle_bot_game *games, size_t n, long *guesses)
+{
+    for (size_t i = 0; i < n; i++) {
+        if (games[i].candidates_len == 0) {
+            guesses[i] = -1;
+            continue;
+        }
+
+        guesses[i] = games[i].candidates[0];
+    }
+}
+
+const struct clidle_bot clidle_bot = {
+    .abi = CLIDLE_BOT_ABI,
+    .name = "first",
+    .init = init,
+    .guess = guess,
+};
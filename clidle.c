@@ -6,15 +6,36 @@
 #include <termios.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
 #include <time.h>
+#include <limits.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
+#include <signal.h>
+#include <pthread.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <dlfcn.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <stdarg.h>
+#include <ctype.h>
 
+#ifndef NO_READLINE
 #include <readline/readline.h>
+#endif
+
+#include <stdatomic.h>
 
 #define SV_IMPLEMENTATION
 #include "sv.h"
 
+#include "clidle_bot.h"
+
 #define BUF_SZ 128
 
 #define GUESSES 6
@@ -23,6 +44,14 @@
 
 #define ASCII_A 0x61
 
+#define KEY_CTRL_D 0x04
+#define KEY_BACKSPACE 0x08
+#define KEY_TAB 0x09
+#define KEY_ESCAPE 0x1b
+/* Tenths of a second to wait for the rest of an escape sequence */
+#define ESCAPE_TIMEOUT 1
+#define KEY_DELETE 0x7f
+
 #define ANSI_UP_LINE "\033[F"
 #define ANSI_UP_N_LINE "\033[%dF"
 #define ANSI_DOWN_N_LINE "\033[%dB"
@@ -31,6 +60,7 @@
 #define ANSI_BACK_GREEN "\033[42m"
 #define ANSI_BACK_YELLOW "\033[43m"
 #define ANSI_BACK_WHITE "\033[47m"
+#define ANSI_RED "\033[31m"
 #define ANSI_RESET "\033[0m"
 
 #define VT100_ERASE "\033[2K"
@@ -41,7 +71,84 @@
 #define WORDS_FILE "words.txt"
 #define WORDS_INDEX 1
 
-#define MMAPPED_FILES 2
+#define BOOK_FILE "book.bin"
+#define BOOK_INDEX 2
+
+#define REPLAY_INDEX 3
+
+#define MMAPPED_FILES 4
+
+/* stdin, stdout and stderr are handed to the zygote */
+#define ZYGOTE_FDS 3
+
+/* Stored in the user's home directory */
+#define HISTORY_FILE ".clidle_history"
+#define SNAPSHOT_FILE ".clidle_stats"
+
+#define SESSION_FILE ".clidle_session"
+#define REPLAY_FILE ".clidle_replays"
+
+#define SNAPSHOT_MAGIC 0x53534c43 /* "CLSS" */
+#define SESSION_MAGIC 0x53474c43 /* "CLGS" */
+
+/* Number of records replayed on top of the snapshot before it is renewed */
+#define CHECKPOINT_INTERVAL 16
+
+/* Number of distinct feedback patterns for a word: 3^LETTERS */
+#define PATTERNS 243
+
+/* Candidates the sampling solver estimates the split with */
+#define SAMPLE_SIZE 256
+/* At most this many guesses are rated exactly after sampling */
+#define SAMPLE_CONTENDERS 64
+/* Width of the confidence interval in standard errors */
+#define SAMPLE_Z 3.0
+
+/* Candidates offered when completing a guess */
+#define COMPLETIONS 10
+
+/* Guesses a tournament game may take before it counts as lost */
+#define TOURNAMENT_LIMIT 16
+/* Games a tournament thread plays side by side, so that a plugin
+ * is asked for this many guesses in one call */
+#define TOURNAMENT_BATCH 64
+
+#define PLUGINS_MAX 8
+
+#define ARENA_PROGRAMS_MAX 8
+/* A bot taking longer than this to answer is stopped */
+#define ARENA_TIMEOUT_MS 10000
+
+/* Largest request the hint service accepts */
+#define HTTP_HEAD_MAX 8192
+#define HTTP_BODY_MAX (1 << 20)
+
+/* Longest a hint may keep a service thread from its other connections */
+#define SERVICE_HINT_BUDGET_MS 50
+
+/* How long a service thread leaves new connections alone once it has
+ * run out of file descriptors, unless one of its own closes first */
+#define ACCEPT_BACKOFF_MS 100
+
+/* Games the service keeps per thread. Once they are all taken, a new
+ * game can only replace one which has not been played for a while. */
+#define GAME_SLOT_BITS 16
+#define SERVICE_GAMES_MAX (1 << GAME_SLOT_BITS)
+#define SERVICE_GAME_IDLE_S 3600
+#define GAME_SHARD_BITS 8
+#define GAME_GENERATION_MASK 0xfffff /* Generations wrap around after this */
+
+/* The assistant lists the candidates once there are at most this many */
+#define ASSISTANT_LIST_MAX 20
+
+/* Words offered when a guess is not in the word list */
+#define SUGGESTIONS 3
+#define SUGGESTION_MAX_DISTANCE 2
+
+#define STRATEGIES 2
+
+#define BOOK_MAGIC 0x4b424c43 /* "CLBK" */
+#define BOOK_NONE UINT16_MAX
 
 enum GuessQuality {
     RightPlace,
@@ -65,20 +172,370 @@ struct Mmapped {
     size_t len;
 };
 
+/* Open addressing hash table from packed words (see pack_word)
+ * to their position in a WordArray */
+struct WordIndex {
+    uint32_t *keys; /* 0 marks a free slot */
+    uint16_t *values;
+    size_t bits;
+};
+
+enum Strategy {
+    Entropy,
+    Minimax,
+};
+
+#ifdef CLIDLE_PROFILE
+/* Call and time counters for the hot paths, printed at exit.
+ * Only compiled in with -DCLIDLE_PROFILE (make PROFILE=1). */
+enum ProfileCounter {
+    ProfValid,
+    ProfQualifyGuess,
+    ProfReprintAlphabet,
+    ProfColorWord,
+    ProfLoadWordArray,
+    ProfIndexBuild,
+    PROFILE_COUNTERS,
+};
+
+static const char *const profile_names[PROFILE_COUNTERS] = {
+    [ProfValid] = "valid",
+    [ProfQualifyGuess] = "qualify_guess",
+    [ProfReprintAlphabet] = "reprint_alphabet",
+    [ProfColorWord] = "color_word_and_update_alphabet",
+    [ProfLoadWordArray] = "load_word_array",
+    [ProfIndexBuild] = "index_build",
+};
+
+/* Atomic because the replay checker calls valid from several threads */
+static _Atomic uint64_t profile_calls[PROFILE_COUNTERS];
+static _Atomic uint64_t profile_ticks[PROFILE_COUNTERS];
+
+/* Cycles where there is a cheap counter for them, nanoseconds elsewhere */
+static inline uint64_t profile_now(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+static void profile_add(enum ProfileCounter counter, uint64_t start)
+{
+    atomic_fetch_add_explicit(&profile_calls[counter], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&profile_ticks[counter], profile_now() - start, memory_order_relaxed);
+}
+
+static void profile_dump(void)
+{
+    fprintf(stderr, "%-32s %12s %16s %12s\n", "function", "calls", "ticks", "ticks/call");
+    for (size_t i = 0; i < PROFILE_COUNTERS; i++) {
+        uint64_t calls = profile_calls[i];
+        uint64_t ticks = profile_ticks[i];
+
+        fprintf(stderr, "%-32s %12llu %16llu %12llu\n", profile_names[i],
+                (unsigned long long)calls, (unsigned long long)ticks,
+                (unsigned long long)(calls ? ticks / calls : 0));
+    }
+}
+
+#define PROFILE_BEGIN(counter) uint64_t profile_start_##counter = profile_now()
+#define PROFILE_END(counter) profile_add(counter, profile_start_##counter)
+#else
+#define PROFILE_BEGIN(counter)
+#define PROFILE_END(counter)
+#endif
+
+/* Prefix tree over words.txt, stored level by level. Node n has a
+ * child for every letter set in mask[n]; the children are stored
+ * next to each other in letter order starting at first[n]. Nodes on
+ * the last level have no children, a set bit there means the word
+ * exists. */
+struct Trie {
+    uint32_t *mask;
+    uint32_t *first;
+    size_t len;
+};
+
+/* A finished span of a traced phase, in microseconds */
+struct TraceSpan {
+    const char *name;
+    uint64_t start;
+    uint64_t dur;
+    size_t turn; /* Guess the input of a "turn" span is for, 0 for other spans */
+};
+
+/* The set of solutions which are still consistent with the feedback
+ * given so far.
+ *
+ * matrix holds the feedback pattern of every word in words.txt (rows)
+ * against every surviving candidate (columns). It is only built when
+ * a hint is first requested and is compacted every time candidates
+ * drop out, so that later turns only touch the columns which are
+ * still relevant instead of the whole solution list. */
+struct Solver {
+    uint16_t *cand; /* Indices into solutions */
+    size_t cand_len;
+    uint8_t *matrix;
+
+    /* History needed to look the position up in the opening book */
+    size_t turn;
+    uint16_t first;
+    uint8_t first_pattern;
+};
+
+/* Best first guess and best second guess for every pattern the
+ * first guess can produce (BOOK_NONE if it cannot occur). */
+struct BookEntry {
+    uint16_t first;
+    uint16_t second[PATTERNS];
+};
+
+/* Layout of BOOK_FILE. The word counts are used to tell
+ * if the book was built for different word lists. */
+struct Book {
+    uint32_t magic;
+    uint32_t words_len;
+    uint32_t solutions_len;
+    struct BookEntry entries[STRATEGIES];
+};
+
+/* One finished game. Records are appended to HISTORY_FILE
+ * and never rewritten, so the file is just an array of these. */
+struct HistoryRecord {
+    uint64_t time;
+    uint16_t solution; /* Index into solutions */
+    uint8_t guesses;
+    uint8_t won;
+    uint8_t pad[4];
+};
+
+struct Stats {
+    size_t played;
+    size_t won;
+    size_t streak;
+    size_t max_streak;
+    size_t distribution[GUESSES];
+};
+
+/* Layout of SNAPSHOT_FILE: the statistics of the first
+ * records entries of the history, so that only the
+ * records after those have to be replayed. */
+struct StatsSnapshot {
+    uint32_t magic;
+    uint64_t records;
+    struct Stats stats;
+};
+
+/* Layout of SESSION_FILE: a game in progress */
+struct Session {
+    uint32_t magic;
+    uint16_t solution; /* Index into solutions */
+    uint8_t guess_count;
+    uint8_t alphabet[ALPHABET_SZ]; /* enum GuessQuality of every letter */
+    char guesses[GUESSES][LETTERS];
+};
+
+enum GameState {
+    GamePlaying,
+    GameWon,
+    GameLost,
+};
+
+/* What one line of input did to a game */
+enum GameEvent {
+    GameIgnored, /* Empty line */
+    GameHintAsked,
+    GameWrongLength,
+    GameUnknownWord,
+    GameGuessed, /* A guess which did not end the game */
+    GameOver, /* The game ended, see its state */
+};
+
+/* A game in progress. It only moves on when game_input is handed the
+ * next line, so a game waiting for input is nothing but this struct:
+ * play drives one from the terminal, the service keeps many of them
+ * suspended between requests. */
+struct Game {
+    uint16_t solution; /* Index into solutions */
+    uint8_t turn; /* Guesses made so far */
+    uint8_t state; /* enum GameState */
+    char guesses[GUESSES][LETTERS];
+    uint8_t patterns[GUESSES];
+};
+
+/* A recorded game. In a replay file every line is one game:
+ * the solution followed by the guesses, separated by spaces. */
+struct Replay {
+    sv solution;
+    sv guesses[GUESSES];
+    size_t guess_count;
+};
+
 static struct CharInfo alphabet[ALPHABET_SZ];
 static struct WordArray words;
+static struct WordArray solutions;
+static struct WordIndex words_index;
+static struct WordIndex solutions_index;
+static struct Trie prefixes;
+/* words.txt packed with pack_word, for scanning it quickly */
+static uint32_t *packed_words;
+
+/* words and words_index are built by words_loader while the first
+ * frame is already on screen. Everything using them goes through
+ * words_wait first. */
+static pthread_t words_loader;
+static bool words_loader_started;
+static atomic_bool words_ready;
+static pthread_mutex_t words_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t words_cond = PTHREAD_COND_INITIALIZER;
+static struct Solver solver;
+static const struct Book *book;
+
+/* Strategies loaded with -P */
+struct Plugin {
+    void *handle;
+    const struct clidle_bot *bot;
+    const char *name;
+    bool ready; /* init was called */
+};
+
+static struct Plugin plugins[PLUGINS_MAX];
+static size_t plugins_len;
 
 /* Here, files, which are mapped into memory are registered
  * to be munmap'd in cleanup. */
 static struct Mmapped mmap_register[MMAPPED_FILES];
 
 static sv solution;
+static size_t solution_index;
+
+/* The game in progress, kept up to date after every guess */
+static struct Session session;
+/* Computed up front because save_session runs in a signal handler */
+static char session_path[PATH_MAX];
+static char session_tmp[PATH_MAX];
+
+/* Spans recorded with -t, written to trace_path at exit */
+static const char *trace_path;
+static struct TraceSpan *trace_spans;
+static size_t trace_len;
+static size_t trace_cap;
+
+/* Read guesses with read_line_raw instead of readline. Without
+ * readline compiled in, that is the only way. */
+#ifdef NO_READLINE
+static bool raw_input = true;
+#else
+static bool raw_input = false;
+#endif
+
+/* The terminal stays in raw mode for the whole game while raw_input
+ * is used. raw_saved is the state to return to at exit. */
+static bool raw_active;
+static struct termios raw_saved;
+
+/* Score repeated letters like the original Wordle instead of like
+ * qualify_guess. Used for games played elsewhere (see assistant). */
+static bool wordle_rules;
+
+/* Time a hint may take in microseconds, 0 for no limit */
+static uint64_t hint_budget;
+/* Estimate hints with solver_best_sampled */
+static bool hint_sampled;
+
+/* Pause between revealing the letters of a guess */
+static struct timespec reveal_delay = { 0, 250000000 };
 
 /* Cursor position on the y-axis */
 static int y = 3;
 
+static uint64_t monotonic_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint64_t trace_begin(void)
+{
+    if (!trace_path)
+        return 0;
+
+    return monotonic_us();
+}
+
+/* Records the span of phase name which started at start */
+static void trace_add(const char *name, uint64_t start, size_t turn)
+{
+    if (!trace_path)
+        return;
+
+    if (trace_len == trace_cap) {
+        trace_cap = trace_cap ? trace_cap * 2 : 256;
+        trace_spans = realloc(trace_spans, trace_cap * sizeof(*trace_spans));
+    }
+
+    trace_spans[trace_len++] = (struct TraceSpan){
+        .name = name,
+        .start = start,
+        .dur = trace_begin() - start,
+        .turn = turn,
+    };
+}
+
+static void trace_end(const char *name, uint64_t start)
+{
+    trace_add(name, start, 0);
+}
+
+/* Ends the span enclosing all phases of one line of input,
+ * so that the trace groups them by the guess they belong to */
+static void trace_end_turn(uint64_t start, size_t turn)
+{
+    trace_add("turn", start, turn);
+}
+
+/* Writes the spans as Chrome trace events, which Perfetto and
+ * chrome://tracing can open */
+static void trace_write(void)
+{
+    if (!trace_path)
+        return;
+
+    FILE *f = fopen(trace_path, "w");
+    if (!f) {
+        perror(trace_path);
+        return;
+    }
+
+    fprintf(f, "{\"traceEvents\":[\n");
+    for (size_t i = 0; i < trace_len; i++) {
+        fprintf(f, "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,\"pid\":%d,\"tid\":1",
+                trace_spans[i].name, (unsigned long long)trace_spans[i].start,
+                (unsigned long long)trace_spans[i].dur, (int)getpid());
+        if (trace_spans[i].turn)
+            fprintf(f, ",\"args\":{\"guess\":%zu}", trace_spans[i].turn);
+        fprintf(f, "}%s\n", i + 1 < trace_len ? "," : "");
+    }
+    fprintf(f, "]}\n");
+
+    if (fclose(f) == EOF)
+        perror(trace_path);
+
+    free(trace_spans);
+}
+
 static struct termios termios_disable_echo(void)
 {
+    /* Echo is already off for the whole game */
+    if (raw_active)
+        return raw_saved;
+
     struct termios old, new;
     if (tcgetattr(STDIN_FILENO, &old) == -1) {
         perror("tcgetattr");
@@ -97,12 +554,46 @@ static struct termios termios_disable_echo(void)
 
 static void termios_restore(const struct termios *old)
 {
+    if (raw_active)
+        return;
+
     if (tcsetattr(STDIN_FILENO, TCSANOW, old) == -1) {
         perror("tcsetattr");
         exit(1);
     }
 }
 
+/* Turns off line buffering and echo once for the whole game */
+static void raw_mode_enable(void)
+{
+    if (tcgetattr(STDIN_FILENO, &raw_saved) == -1) {
+        perror("tcgetattr");
+        exit(1);
+    }
+
+    struct termios raw = raw_saved;
+    raw.c_lflag &= ~(ICANON | ECHO);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+
+    if (tcsetattr(STDIN_FILENO, TCSANOW, &raw) == -1) {
+        perror("tcsetattr");
+        exit(1);
+    }
+
+    raw_active = true;
+}
+
+/* Async-signal-safe, so it can run on SIGHUP */
+static void raw_mode_disable(void)
+{
+    if (!raw_active)
+        return;
+
+    raw_active = false;
+    tcsetattr(STDIN_FILENO, TCSANOW, &raw_saved);
+}
+
 static sv map_file(const char *file)
 {
     int fd = open(file, O_RDONLY);
@@ -118,6 +609,12 @@ static sv map_file(const char *file)
         exit(1);
     }
 
+    /* mmap refuses to map nothing */
+    if (statbuf.st_size == 0) {
+        close(fd);
+        return sv_from_data(NULL, 0);
+    }
+
     char *contents = mmap(NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
 
     if (contents == MAP_FAILED) {
@@ -139,259 +636,4476 @@ static size_t count_lines(const sv file)
     return ret;
 }
 
-/* Chooses a random solution from the solution file */
-static void choose_solution(void)
+/* Packs a word of LETTERS lowercase letters into 5 bits per letter.
+ * Returns 0, which no word packs to, for anything else. */
+static uint32_t pack_word(const char *word, size_t len)
 {
-    sv file = map_file(SOLUTION_FILE);
-    mmap_register[SOLUTION_INDEX] = (struct Mmapped){
-        .ptr = (void *)file.ptr,
-        .len = file.len,
-    };
-
-    sv buf;
-
-    size_t lines = count_lines(file);
+    if (len != LETTERS)
+        return 0;
 
-    sv *words = malloc(lines * sizeof(*words));
+    uint32_t packed = 0;
+    for (size_t i = 0; i < LETTERS; i++) {
+        if (word[i] < 'a' || word[i] > 'z')
+            return 0;
 
-    size_t i = 0;
-    while (sv_chop_delim('\n', &file, &buf)) {
-        words[i++] = buf;
+        packed = packed << 5 | (word[i] - ASCII_A + 1);
     }
 
-    solution = words[rand() % lines];
+    return packed;
+}
 
-    free(words);
+static size_t index_slot(const struct WordIndex *index, uint32_t key)
+{
+    return (uint32_t)(key * 2654435761u) >> (32 - index->bits);
 }
 
-static void init_words(void)
+static void index_build(struct WordIndex *index, const struct WordArray *arr)
 {
-    sv file = map_file(WORDS_FILE);
-    mmap_register[WORDS_INDEX] = (struct Mmapped){
-        .ptr = (void *)file.ptr,
-        .len = file.len,
-    };
+    assert(arr->len <= UINT16_MAX);
 
-    sv buf;
+    PROFILE_BEGIN(ProfIndexBuild);
 
-    size_t lines = count_lines(file);
+    /* Keep the table at most half full */
+    index->bits = 1;
+    while ((1u << index->bits) < arr->len * 2) {
+        index->bits += 1;
+    }
 
-    words.array = malloc(lines * sizeof(sv));
-    words.len = lines;
+    size_t mask = (1u << index->bits) - 1;
+    index->keys = calloc(mask + 1, sizeof(*index->keys));
+    index->values = malloc((mask + 1) * sizeof(*index->values));
 
-    size_t i = 0;
-    while (sv_chop_delim('\n', &file, &buf)) {
-        words.array[i++] = buf;
+    for (size_t i = 0; i < arr->len; i++) {
+        uint32_t key = pack_word(arr->array[i].ptr, arr->array[i].len);
+        if (!key)
+            continue;
+
+        size_t slot = index_slot(index, key);
+        while (index->keys[slot] && index->keys[slot] != key) {
+            slot = (slot + 1) & mask;
+        }
+
+        if (!index->keys[slot]) {
+            index->keys[slot] = key;
+            index->values[slot] = i;
+        }
     }
+
+    PROFILE_END(ProfIndexBuild);
 }
 
-static void init_alphabet(void)
+static void index_free(struct WordIndex *index)
 {
-    for (size_t c = 'a' - ASCII_A; c <= 'z' - ASCII_A; c++) {
-        alphabet[c] = (struct CharInfo){
-            .chr = c + ASCII_A,
-            .quality = Unknown,
-        };
-    }
+    free(index->keys);
+    free(index->values);
 }
 
-/* NOTE: This could be a hashtable but I won't bother ... */
-static bool valid(const char *word)
+/* Returns the position of word in the indexed array or -1 */
+static long index_lookup(const struct WordIndex *index, const char *word, size_t len)
 {
-    for (size_t i = 0; i < words.len; i++) {
-        if (sv_cstr_eq(words.array[i], word)) {
-            return true;
-        }
+    uint32_t key = pack_word(word, len);
+    if (!key)
+        return -1;
+
+    size_t mask = (1u << index->bits) - 1;
+    for (size_t slot = index_slot(index, key); index->keys[slot]; slot = (slot + 1) & mask) {
+        if (index->keys[slot] == key)
+            return index->values[slot];
     }
 
-    return false;
+    return -1;
 }
 
-static enum GuessQuality qualify_guess(const char *guess, size_t index)
+static int compare_packed(const void *a, const void *b)
 {
-    const char c = guess[index];
-
-    if (solution.ptr[index] == c)
-        return RightPlace;
-
-    for (size_t i = 0; i < LETTERS; i++) {
-        /* If we find the letter somewhere we have to ensure it has not already been guessed correctly there */
-        if (solution.ptr[i] == c && guess[i] != c)
-            return WrongPlace;
-    }
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
 
-    return Wrong;
+    return (x > y) - (x < y);
 }
 
-/* Does the guess quality new have higher importance than orig?
- * E.g.: Character 'c' is colored yellow but was now guessed in
- * the right spot. It should now be colored green. Character 'b'
- * is colored green and was now guessed in the wrong spot. It should
- * not be recolored. */
-static bool overrides(enum GuessQuality orig, enum GuessQuality new)
+/* Packed words sort like the words themselves, so after sorting the
+ * distinct prefixes of each length come out in the order their nodes
+ * are laid out in. */
+static void trie_build(struct Trie *trie, const struct WordArray *arr)
 {
-    assert(new != Unknown);
+    uint32_t *keys = malloc(arr->len * sizeof(*keys));
+    size_t len = 0;
 
-    if (orig == RightPlace)
-        return false;
+    for (size_t i = 0; i < arr->len; i++) {
+        uint32_t key = pack_word(arr->array[i].ptr, arr->array[i].len);
+        if (key)
+            keys[len++] = key;
+    }
 
-    if (orig == Unknown || orig == Wrong)
-        return true;
+    qsort(keys, len, sizeof(*keys), compare_packed);
 
-    if (orig == WrongPlace && new == RightPlace)
-        return true;
+    /* Upper bound: every word adds at most one node per level */
+    size_t cap = 1 + len * (LETTERS - 1);
+    trie->mask = calloc(cap, sizeof(*trie->mask));
+    trie->first = calloc(cap, sizeof(*trie->first));
+    trie->len = 0;
 
-    return false;
-}
+    size_t level_start = 0;
+    size_t level_len = len ? 1 : 0;
 
-static void print_qualified_char(char c, enum GuessQuality quality)
-{
-    switch (quality) {
-        case RightPlace:
-            printf(ANSI_BACK_GREEN ANSI_BLACK "%c" ANSI_RESET, c);
-            break;
-        case WrongPlace:
-            printf(ANSI_BACK_YELLOW ANSI_BLACK "%c" ANSI_RESET, c);
-            break;
-        case Wrong:
-            printf(ANSI_BACK_WHITE ANSI_GRAY "%c" ANSI_RESET, c);
-            break;
-        case Unknown:
-            printf("%c", c);
-            break;
-    }
-}
+    for (size_t depth = 0; depth < LETTERS; depth++) {
+        size_t next_start = level_start + level_len;
+        size_t next_len = 0;
+        size_t node = level_start - 1;
+        uint32_t node_prefix = UINT32_MAX;
+        uint32_t child_prefix = UINT32_MAX;
 
-/* Goes to the first line, erases it, prints msg, waits a moment
- * and goes back to where the next input is */
-static void misinput(const char *msg)
-{
-    static const struct timespec nanosleep_request = { 0, 750000000 };
+        for (size_t i = 0; i < len; i++) {
+            uint32_t prefix = keys[i] >> (5 * (LETTERS - depth));
+            uint32_t child = keys[i] >> (5 * (LETTERS - depth - 1));
 
-    struct termios old = termios_disable_echo();
+            if (prefix != node_prefix) {
+                node += 1;
+                node_prefix = prefix;
+                trie->first[node] = next_start + next_len;
+            }
 
-    printf(ANSI_UP_N_LINE VT100_ERASE "%s", y, msg);
-    fflush(stdout);
+            if (child != child_prefix) {
+                child_prefix = child;
+                trie->mask[node] |= 1u << ((child & 0x1f) - 1);
+                if (depth + 1 < LETTERS)
+                    next_len += 1;
+            }
+        }
 
-    nanosleep(&nanosleep_request, NULL);
+        level_start = next_start;
+        level_len = next_len;
+    }
 
-    printf("\r" VT100_ERASE ANSI_DOWN_N_LINE VT100_ERASE, y - 1);
-    fflush(stdout);
+    trie->len = level_start;
 
-    termios_restore(&old);
+    free(keys);
 }
 
-/* Prints the alphabet in the line under the current one and goes back up */
-static void reprint_alphabet(void)
+static void trie_free(struct Trie *trie)
 {
-    printf("\n");
-    for (size_t i = 0; i < ALPHABET_SZ; i++) {
-        print_qualified_char(alphabet[i].chr, alphabet[i].quality);
-    }
-    printf(ANSI_UP_LINE);
-    fflush(stdout);
+    free(trie->mask);
+    free(trie->first);
 }
 
-/* Goes up line and reprints chars with colored quality
- * and waits between each char. */
-static void color_word_and_update_alphabet(const char *guess)
+/* Can prefix (lowercase letters only) still be completed to a word? */
+static bool trie_has_prefix(const struct Trie *trie, const char *prefix, size_t len)
 {
-    static const struct timespec nanosleep_request = { 0, 250000000 };
-
-    struct termios old = termios_disable_echo();
+    if (trie->len == 0)
+        return false;
 
-    printf(ANSI_UP_LINE);
+    size_t node = 0;
 
-    for (size_t i = 0; i < LETTERS; i++) {
-        enum GuessQuality quality = qualify_guess(guess, i);
+    for (size_t i = 0; i < len; i++) {
+        uint32_t bit = 1u << (prefix[i] - ASCII_A);
 
-        print_qualified_char(guess[i], quality);
-        fflush(stdout);
+        if (!(trie->mask[node] & bit))
+            return false;
 
-        if (overrides(alphabet[(int)guess[i] - ASCII_A].quality, quality)) {
-            alphabet[(int)guess[i] - ASCII_A].quality = quality; /* Update alphabet coloring accordingly (see overrides function) */
-        }
+        if (i + 1 == LETTERS)
+            break;
 
-        nanosleep(&nanosleep_request, NULL);
+        node = trie->first[node] + __builtin_popcount(trie->mask[node] & (bit - 1));
     }
-    printf("\n");
 
-    termios_restore(&old);
+    return true;
 }
 
-static inline bool check_correct(const char *guess)
+static void load_word_array(const char *file_name, size_t index, struct WordArray *arr)
 {
-    return sv_cstr_eq(solution, guess);
+    PROFILE_BEGIN(ProfLoadWordArray);
+
+    sv file = map_file(file_name);
+    mmap_register[index] = (struct Mmapped){
+        .ptr = (void *)file.ptr,
+        .len = file.len,
+    };
+
+    sv buf;
+
+    size_t lines = count_lines(file);
+
+    arr->array = malloc(lines * sizeof(sv));
+    arr->len = lines;
+
+    size_t i = 0;
+    while (sv_chop_delim('\n', &file, &buf)) {
+        arr->array[i++] = buf;
+    }
+
+    PROFILE_END(ProfLoadWordArray);
+}
+
+static void init_solutions(void)
+{
+    load_word_array(SOLUTION_FILE, SOLUTION_INDEX, &solutions);
+    index_build(&solutions_index, &solutions);
+}
+
+/* Chooses a random solution from the solution file */
+static void choose_solution(void)
+{
+    solution_index = rand() % solutions.len;
+    solution = solutions.array[solution_index];
+}
+
+static void init_words(void)
+{
+    load_word_array(WORDS_FILE, WORDS_INDEX, &words);
+    index_build(&words_index, &words);
+    trie_build(&prefixes, &words);
+
+    packed_words = malloc(words.len * sizeof(*packed_words));
+    for (size_t i = 0; i < words.len; i++) {
+        packed_words[i] = pack_word(words.array[i].ptr, words.array[i].len);
+    }
+}
+
+static void init_alphabet(void)
+{
+    for (size_t c = 'a' - ASCII_A; c <= 'z' - ASCII_A; c++) {
+        alphabet[c] = (struct CharInfo){
+            .chr = c + ASCII_A,
+            .quality = Unknown,
+        };
+    }
+}
+
+/* Blocks until words_loader is done. Cheap once it is. */
+static void words_wait(void)
+{
+    if (atomic_load_explicit(&words_ready, memory_order_acquire))
+        return;
+
+    pthread_mutex_lock(&words_lock);
+    while (!atomic_load_explicit(&words_ready, memory_order_acquire)) {
+        pthread_cond_wait(&words_cond, &words_lock);
+    }
+    pthread_mutex_unlock(&words_lock);
+}
+
+/* Returns the position of word in words.txt or -1 if it is not in there */
+static long word_index(const char *word)
+{
+    words_wait();
+
+    return index_lookup(&words_index, word, strlen(word));
+}
+
+/* Number of letters in which two packed words differ. All 5 bits of
+ * a letter are folded onto its lowest bit, which are then counted. */
+static int packed_distance(uint32_t a, uint32_t b)
+{
+    uint32_t x = a ^ b;
+
+    x |= x >> 1 | x >> 2 | x >> 3 | x >> 4;
+
+    return __builtin_popcount(x & 0x108421);
+}
+
+/* Finds up to SUGGESTIONS words differing from guess in the fewest
+ * letters, at most SUGGESTION_MAX_DISTANCE. Returns how many it found. */
+static size_t suggest(const char *guess, long out[SUGGESTIONS])
+{
+    uint32_t key = pack_word(guess, strlen(guess));
+    if (!key)
+        return 0;
+
+    words_wait();
+
+    int distances[SUGGESTIONS];
+    size_t found = 0;
+
+    for (size_t i = 0; i < words.len; i++) {
+        int distance = packed_distance(key, packed_words[i]);
+
+        if (distance > SUGGESTION_MAX_DISTANCE || (found == SUGGESTIONS && distance >= distances[found - 1]))
+            continue;
+
+        /* Insert sorted by distance, earlier words win ties */
+        size_t pos = found < SUGGESTIONS ? found++ : SUGGESTIONS - 1;
+        while (pos > 0 && distances[pos - 1] > distance) {
+            distances[pos] = distances[pos - 1];
+            out[pos] = out[pos - 1];
+            pos -= 1;
+        }
+
+        distances[pos] = distance;
+        out[pos] = i;
+    }
+
+    return found;
+}
+
+/* Builds the message for a guess which is not in the word list */
+static void not_in_word_list(const char *guess, char *msg, size_t msglen)
+{
+    long suggestions[SUGGESTIONS];
+    size_t found = suggest(guess, suggestions);
+
+    size_t len = snprintf(msg, msglen, "Not in word list");
+
+    for (size_t i = 0; i < found && len < msglen; i++) {
+        len += snprintf(msg + len, msglen - len, "%s"SV_Fmt, i ? ", " : ", did you mean ",
+                        SV_Arg(words.array[suggestions[i]]));
+    }
+
+    if (found && len < msglen)
+        snprintf(msg + len, msglen - len, "?");
+}
+
+static bool valid(const char *word)
+{
+    PROFILE_BEGIN(ProfValid);
+
+    bool ret = word_index(word) != -1;
+
+    PROFILE_END(ProfValid);
+
+    return ret;
+}
+
+static enum GuessQuality qualify_guess(const char *guess, const char *answer, size_t index)
+{
+    PROFILE_BEGIN(ProfQualifyGuess);
+
+    const char c = guess[index];
+    enum GuessQuality quality = Wrong;
+
+    if (answer[index] == c) {
+        quality = RightPlace;
+    } else {
+        for (size_t i = 0; i < LETTERS; i++) {
+            /* If we find the letter somewhere we have to ensure it has not already been guessed correctly there */
+            if (answer[i] == c && guess[i] != c) {
+                quality = WrongPlace;
+                break;
+            }
+        }
+    }
+
+    PROFILE_END(ProfQualifyGuess);
+
+    return quality;
+}
+
+/* Like score_word, but with the original Wordle's rule for repeated
+ * letters: every letter of the answer can only mark one letter of the
+ * guess, the leftmost ones first. */
+static uint8_t score_word_wordle(const char *guess, const char *answer)
+{
+    /* Letters of the answer which were not guessed in the right place */
+    uint8_t open[ALPHABET_SZ] = { 0 };
+    for (size_t i = 0; i < LETTERS; i++) {
+        if (guess[i] != answer[i])
+            open[answer[i] - ASCII_A] += 1;
+    }
+
+    enum GuessQuality qualities[LETTERS];
+    for (size_t i = 0; i < LETTERS; i++) {
+        if (guess[i] == answer[i]) {
+            qualities[i] = RightPlace;
+        } else if (open[guess[i] - ASCII_A]) {
+            open[guess[i] - ASCII_A] -= 1;
+            qualities[i] = WrongPlace;
+        } else {
+            qualities[i] = Wrong;
+        }
+    }
+
+    uint8_t pattern = 0;
+    for (size_t i = LETTERS; i-- > 0;) {
+        pattern = pattern * 3 + qualities[i];
+    }
+
+    return pattern;
+}
+
+/* Computes the feedback for the whole word at once, encoded with one
+ * base-3 digit per letter (the first letter being the least significant).
+ * Gives the same result as calling qualify_guess for every letter.
+ * Since RightPlace is 0, a solved word is pattern 0. */
+static uint8_t score_word(const char *guess, const char *answer)
+{
+    if (wordle_rules)
+        return score_word_wordle(guess, answer);
+
+    /* Letters of the answer which were not guessed in the right place */
+    uint32_t open = 0;
+    for (size_t i = 0; i < LETTERS; i++) {
+        if (guess[i] != answer[i])
+            open |= 1u << (answer[i] - ASCII_A);
+    }
+
+    uint8_t pattern = 0;
+    for (size_t i = LETTERS; i-- > 0;) {
+        enum GuessQuality quality;
+        if (guess[i] == answer[i])
+            quality = RightPlace;
+        else if (open & (1u << (guess[i] - ASCII_A)))
+            quality = WrongPlace;
+        else
+            quality = Wrong;
+
+        pattern = pattern * 3 + quality;
+    }
+
+    return pattern;
+}
+
+static void solver_init(struct Solver *s)
+{
+    s->cand = malloc(solutions.len * sizeof(*s->cand));
+    s->cand_len = solutions.len;
+    s->matrix = NULL;
+    s->turn = 0;
+
+    for (size_t i = 0; i < solutions.len; i++) {
+        s->cand[i] = i;
+    }
+}
+
+static void solver_free(struct Solver *s)
+{
+    free(s->cand);
+    free(s->matrix);
+}
+
+/* Makes dst an independent copy of src, including the matrix if built */
+static void solver_copy(struct Solver *dst, const struct Solver *src)
+{
+    *dst = *src;
+
+    dst->cand = malloc(solutions.len * sizeof(*dst->cand));
+    memcpy(dst->cand, src->cand, src->cand_len * sizeof(*dst->cand));
+
+    if (src->matrix) {
+        dst->matrix = malloc(words.len * src->cand_len);
+        memcpy(dst->matrix, src->matrix, words.len * src->cand_len);
+    }
+}
+
+static void solver_build_matrix(struct Solver *s)
+{
+    s->matrix = malloc(words.len * s->cand_len);
+
+    for (size_t g = 0; g < words.len; g++) {
+        uint8_t *row = s->matrix + g * s->cand_len;
+        for (size_t j = 0; j < s->cand_len; j++) {
+            row[j] = score_word(words.array[g].ptr, solutions.array[s->cand[j]].ptr);
+        }
+    }
+}
+
+/* Drops every candidate which would not have produced pattern for the guess g */
+static void solver_filter(struct Solver *s, size_t g, uint8_t pattern)
+{
+    size_t old_len = s->cand_len;
+    size_t new_len = 0;
+
+    if (s->turn++ == 0) {
+        s->first = g;
+        s->first_pattern = pattern;
+    }
+
+    if (!s->matrix) {
+        for (size_t j = 0; j < old_len; j++) {
+            if (score_word(words.array[g].ptr, solutions.array[s->cand[j]].ptr) == pattern)
+                s->cand[new_len++] = s->cand[j];
+        }
+        s->cand_len = new_len;
+        return;
+    }
+
+    const uint8_t *guess_row = s->matrix + g * old_len;
+    uint16_t *keep = malloc(old_len * sizeof(*keep));
+
+    for (size_t j = 0; j < old_len; j++) {
+        if (guess_row[j] == pattern) {
+            keep[new_len] = j;
+            s->cand[new_len++] = s->cand[j];
+        }
+    }
+
+    /* Compact the matrix in place. Every destination lies at or before its
+     * source, so a forward copy never overwrites anything still needed. */
+    for (size_t r = 0; r < words.len; r++) {
+        const uint8_t *src = s->matrix + r * old_len;
+        uint8_t *dst = s->matrix + r * new_len;
+        for (size_t k = 0; k < new_len; k++) {
+            dst[k] = src[keep[k]];
+        }
+    }
+
+    free(keep);
+
+    s->cand_len = new_len;
+}
+
+/* Rates the split of the candidates a guess produces. Lower is better. */
+static double rate_split(const uint16_t *buckets, size_t total, enum Strategy strategy)
+{
+    double rating = 0;
+
+    switch (strategy) {
+        case Entropy:
+            for (size_t p = 0; p < PATTERNS; p++) {
+                if (buckets[p]) {
+                    double prob = (double)buckets[p] / total;
+                    rating += prob * log2(prob); /* Negative entropy */
+                }
+            }
+            break;
+        case Minimax:
+            for (size_t p = 0; p < PATTERNS; p++) {
+                if (buckets[p] > rating)
+                    rating = buckets[p];
+            }
+            break;
+    }
+
+    return rating;
+}
+
+/* Rates guess g against the remaining candidates, see rate_split.
+ * Uses the matrix if it was built already. */
+static double rate_guess(const struct Solver *s, size_t g, enum Strategy strategy, bool *is_cand)
+{
+    uint16_t buckets[PATTERNS] = { 0 };
+
+    if (s->matrix) {
+        const uint8_t *row = s->matrix + g * s->cand_len;
+        for (size_t j = 0; j < s->cand_len; j++) {
+            buckets[row[j]] += 1;
+        }
+    } else {
+        for (size_t j = 0; j < s->cand_len; j++) {
+            buckets[score_word(words.array[g].ptr, solutions.array[s->cand[j]].ptr)] += 1;
+        }
+    }
+
+    *is_cand = buckets[0] != 0;
+
+    return rate_split(buckets, s->cand_len, strategy);
+}
+
+/* Returns the index of the word in words.txt which splits the
+ * remaining candidates best or -1 if there are none left. */
+static long solver_best(struct Solver *s, enum Strategy strategy)
+{
+    if (s->cand_len == 0)
+        return -1;
+
+    if (!s->matrix)
+        solver_build_matrix(s);
+
+    long best = -1;
+    double best_rating = INFINITY;
+    bool best_is_cand = false;
+
+    for (size_t g = 0; g < words.len; g++) {
+        bool is_cand;
+        double rating = rate_guess(s, g, strategy, &is_cand);
+
+        /* A guess which could be the solution wins ties */
+        if (rating < best_rating || (rating == best_rating && is_cand && !best_is_cand)) {
+            best = g;
+            best_rating = rating;
+            best_is_cand = is_cand;
+        }
+    }
+
+    return best;
+}
+
+struct RankedGuess {
+    uint32_t score;
+    uint16_t word;
+};
+
+static int compare_ranked(const void *a, const void *b)
+{
+    const struct RankedGuess *x = a;
+    const struct RankedGuess *y = b;
+
+    /* Highest score first, then in word list order */
+    if (x->score != y->score)
+        return (x->score < y->score) - (x->score > y->score);
+
+    return (x->word > y->word) - (x->word < y->word);
+}
+
+static uint32_t xorshift32(uint32_t *state)
+{
+    uint32_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+
+    return *state = x;
+}
+
+struct SampledGuess {
+    double estimate; /* Rating on the sample */
+    double bound; /* Optimistic end of its confidence interval */
+    uint16_t word;
+};
+
+static int compare_sampled(const void *a, const void *b)
+{
+    const struct SampledGuess *x = a;
+    const struct SampledGuess *y = b;
+
+    if (x->bound != y->bound)
+        return (x->bound > y->bound) - (x->bound < y->bound);
+
+    return (x->word > y->word) - (x->word < y->word);
+}
+
+/* Like solver_best, but for large candidate sets the split of every
+ * guess is only estimated on a random sample of SAMPLE_SIZE candidates.
+ * For Entropy, every guess whose confidence interval overlaps that of
+ * the best estimate is a contender; for Minimax the best estimates are.
+ * At most SAMPLE_CONTENDERS of them are then rated exactly. */
+static long solver_best_sampled(struct Solver *s, enum Strategy strategy, uint32_t seed)
+{
+    if (s->cand_len <= SAMPLE_SIZE)
+        return solver_best(s, strategy);
+
+    /* Draw the sample with a partial Fisher-Yates shuffle */
+    uint16_t *pool = malloc(s->cand_len * sizeof(*pool));
+    memcpy(pool, s->cand, s->cand_len * sizeof(*pool));
+
+    uint32_t state = seed ? seed : 1;
+    for (size_t i = 0; i < SAMPLE_SIZE; i++) {
+        size_t j = i + xorshift32(&state) % (s->cand_len - i);
+        uint16_t tmp = pool[i];
+        pool[i] = pool[j];
+        pool[j] = tmp;
+    }
+
+    struct SampledGuess *guesses = malloc(words.len * sizeof(*guesses));
+    double best_worst = INFINITY; /* Pessimistic end of the best interval */
+
+    for (size_t g = 0; g < words.len; g++) {
+        uint16_t buckets[PATTERNS] = { 0 };
+        for (size_t j = 0; j < SAMPLE_SIZE; j++) {
+            buckets[score_word(words.array[g].ptr, solutions.array[pool[j]].ptr)] += 1;
+        }
+
+        double estimate = rate_split(buckets, SAMPLE_SIZE, strategy);
+        double error = 0;
+
+        if (strategy == Entropy) {
+            /* Standard error of the plug-in entropy estimate */
+            double second = 0;
+            for (size_t p = 0; p < PATTERNS; p++) {
+                if (buckets[p]) {
+                    double prob = (double)buckets[p] / SAMPLE_SIZE;
+                    second += prob * log2(prob) * log2(prob);
+                }
+            }
+            error = SAMPLE_Z * sqrt(fmax(second - estimate * estimate, 0) / SAMPLE_SIZE);
+        }
+
+        guesses[g] = (struct SampledGuess){
+            .estimate = estimate,
+            .bound = estimate - error,
+            .word = g,
+        };
+
+        if (estimate + error < best_worst)
+            best_worst = estimate + error;
+    }
+
+    free(pool);
+
+    qsort(guesses, words.len, sizeof(*guesses), compare_sampled);
+
+    long best = -1;
+    double best_rating = INFINITY;
+    bool best_is_cand = false;
+
+    for (size_t k = 0; k < words.len && k < SAMPLE_CONTENDERS; k++) {
+        if (strategy == Entropy && guesses[k].bound > best_worst)
+            break; /* Cannot be better than the best estimate */
+
+        bool is_cand;
+        double rating = rate_guess(s, guesses[k].word, strategy, &is_cand);
+
+        if (rating < best_rating || (rating == best_rating && is_cand && !best_is_cand)) {
+            best = guesses[k].word;
+            best_rating = rating;
+            best_is_cand = is_cand;
+        }
+    }
+
+    free(guesses);
+
+    return best;
+}
+
+/* Counts the candidates containing each letter */
+static void letter_counts(const struct Solver *s, uint32_t contained[ALPHABET_SZ])
+{
+    memset(contained, 0, ALPHABET_SZ * sizeof(*contained));
+
+    for (size_t j = 0; j < s->cand_len; j++) {
+        uint32_t letters = 0;
+        for (size_t i = 0; i < LETTERS; i++) {
+            letters |= 1u << (solutions.array[s->cand[j]].ptr[i] - ASCII_A);
+        }
+        for (size_t c = 0; c < ALPHABET_SZ; c++) {
+            contained[c] += (letters >> c) & 1;
+        }
+    }
+}
+
+/* Cheap estimate of how well word splits the candidates, higher is
+ * better: a letter splits them best if about half of them contain it. */
+static uint32_t letter_score(const struct Solver *s, const uint32_t contained[ALPHABET_SZ], const char *word)
+{
+    uint32_t letters = 0;
+    for (size_t i = 0; i < LETTERS; i++) {
+        letters |= 1u << (word[i] - ASCII_A);
+    }
+
+    uint32_t score = 0;
+    for (size_t c = 0; c < ALPHABET_SZ; c++) {
+        if (letters & (1u << c)) {
+            uint32_t without = s->cand_len - contained[c];
+            score += contained[c] < without ? contained[c] : without;
+        }
+    }
+
+    return score;
+}
+
+/* Like solver_best, but gives up after budget_us microseconds and
+ * returns the best guess found until then. Guesses are tried in the
+ * order of letter_score. */
+static long solver_best_within(struct Solver *s, enum Strategy strategy, uint64_t budget_us)
+{
+    uint64_t deadline = monotonic_us() + budget_us;
+
+    if (s->cand_len == 0)
+        return -1;
+
+    uint32_t contained[ALPHABET_SZ];
+    letter_counts(s, contained);
+
+    struct RankedGuess *order = malloc(words.len * sizeof(*order));
+
+    for (size_t g = 0; g < words.len; g++) {
+        order[g] = (struct RankedGuess){
+            .score = letter_score(s, contained, words.array[g].ptr),
+            .word = g,
+        };
+    }
+
+    qsort(order, words.len, sizeof(*order), compare_ranked);
+
+    long best = -1;
+    double best_rating = INFINITY;
+    bool best_is_cand = false;
+
+    for (size_t k = 0; k < words.len; k++) {
+        bool is_cand;
+        double rating = rate_guess(s, order[k].word, strategy, &is_cand);
+
+        if (rating < best_rating || (rating == best_rating && is_cand && !best_is_cand)) {
+            best = order[k].word;
+            best_rating = rating;
+            best_is_cand = is_cand;
+        }
+
+        if (monotonic_us() >= deadline)
+            break;
+    }
+
+    free(order);
+
+    return best;
+}
+
+/* A candidate and how well it splits the others, lower is better */
+struct RatedCandidate {
+    double rating;
+    uint16_t solution;
+};
+
+static int compare_rated(const void *a, const void *b)
+{
+    const struct RatedCandidate *x = a;
+    const struct RatedCandidate *y = b;
+
+    /* Best first, then in solution list order */
+    if (x->rating != y->rating)
+        return (x->rating > y->rating) - (x->rating < y->rating);
+
+    return (x->solution > y->solution) - (x->solution < y->solution);
+}
+
+/* The candidates completions were last rated for and the same ones
+ * best first, so every turn only pays for rating them once */
+static uint16_t *rated_cand;
+static uint16_t *rated_order;
+static size_t rated_len = SIZE_MAX;
+
+static void rate_candidates(const struct Solver *s)
+{
+    if (rated_len == s->cand_len
+        && (s->cand_len == 0 || memcmp(rated_cand, s->cand, s->cand_len * sizeof(*s->cand)) == 0))
+        return;
+
+    struct RatedCandidate *rated = malloc((s->cand_len + 1) * sizeof(*rated));
+
+    for (size_t i = 0; i < s->cand_len; i++) {
+        const char *word = solutions.array[s->cand[i]].ptr;
+
+        uint16_t buckets[PATTERNS] = { 0 };
+        for (size_t j = 0; j < s->cand_len; j++) {
+            buckets[score_word(word, solutions.array[s->cand[j]].ptr)] += 1;
+        }
+
+        rated[i] = (struct RatedCandidate){
+            .rating = rate_split(buckets, s->cand_len, Entropy),
+            .solution = s->cand[i],
+        };
+    }
+
+    qsort(rated, s->cand_len, sizeof(*rated), compare_rated);
+
+    rated_cand = realloc(rated_cand, (s->cand_len + 1) * sizeof(*rated_cand));
+    rated_order = realloc(rated_order, (s->cand_len + 1) * sizeof(*rated_order));
+    memcpy(rated_cand, s->cand, s->cand_len * sizeof(*s->cand));
+
+    for (size_t i = 0; i < s->cand_len; i++) {
+        rated_order[i] = rated[i].solution;
+    }
+
+    rated_len = s->cand_len;
+    free(rated);
+}
+
+/* Rating every solution against every other one takes a noticeable
+ * moment, so the first turn's are rated while the player is thinking */
+static pthread_t rating_thread;
+static bool rating_started;
+
+static void *rate_in_background(void *arg)
+{
+    struct Solver *s = arg;
+
+    rate_candidates(s);
+
+    free(s->cand);
+    free(s);
+
+    return NULL;
+}
+
+static void start_rating(const struct Solver *s)
+{
+    struct Solver *copy = malloc(sizeof(*copy));
+    *copy = (struct Solver){
+        .cand = malloc((s->cand_len + 1) * sizeof(*copy->cand)),
+        .cand_len = s->cand_len,
+    };
+    memcpy(copy->cand, s->cand, s->cand_len * sizeof(*copy->cand));
+
+    if (pthread_create(&rating_thread, NULL, rate_in_background, copy) != 0) {
+        /* Tab rates them when it is first pressed */
+        free(copy->cand);
+        free(copy);
+        return;
+    }
+
+    rating_started = true;
+}
+
+/* Finds up to COMPLETIONS candidates starting with prefix, the ones
+ * splitting the other candidates best first. Returns how many. */
+static size_t complete(const struct Solver *s, const char *prefix, size_t len, uint16_t out[COMPLETIONS])
+{
+    if (rating_started) {
+        pthread_join(rating_thread, NULL);
+        rating_started = false;
+    }
+
+    rate_candidates(s);
+
+    size_t found = 0;
+
+    for (size_t i = 0; i < rated_len && found < COMPLETIONS; i++) {
+        if (memcmp(solutions.array[rated_order[i]].ptr, prefix, len) == 0)
+            out[found++] = rated_order[i];
+    }
+
+    return found;
+}
+
+#ifndef NO_READLINE
+/* readline completion generator, see rl_completion_matches */
+static char *complete_generator(const char *text, int state)
+{
+    static uint16_t matches[COMPLETIONS];
+    static size_t count;
+    static size_t next;
+
+    if (state == 0) {
+        count = complete(&solver, text, strlen(text), matches);
+        next = 0;
+    }
+
+    if (next == count)
+        return NULL;
+
+    sv word = solutions.array[matches[next++]];
+    char *ret = malloc(word.len + 1);
+
+    return sv_to_cstr(word, ret, word.len + 1);
+}
+
+static char **complete_readline(const char *text, int start, int end)
+{
+    (void)start;
+    (void)end;
+
+    rl_attempted_completion_over = 1; /* No file names */
+    rl_completion_append_character = '\0';
+
+    if (strlen(text) > LETTERS)
+        return NULL;
+
+    return rl_completion_matches(text, complete_generator);
+}
+#endif
+
+/* Does the guess quality new have higher importance than orig?
+ * E.g.: Character 'c' is colored yellow but was now guessed in
+ * the right spot. It should now be colored green. Character 'b'
+ * is colored green and was now guessed in the wrong spot. It should
+ * not be recolored. */
+static bool overrides(enum GuessQuality orig, enum GuessQuality new)
+{
+    assert(new != Unknown);
+
+    if (orig == RightPlace)
+        return false;
+
+    if (orig == Unknown || orig == Wrong)
+        return true;
+
+    if (orig == WrongPlace && new == RightPlace)
+        return true;
+
+    return false;
+}
+
+static void print_qualified_char(char c, enum GuessQuality quality)
+{
+    switch (quality) {
+        case RightPlace:
+            printf(ANSI_BACK_GREEN ANSI_BLACK "%c" ANSI_RESET, c);
+            break;
+        case WrongPlace:
+            printf(ANSI_BACK_YELLOW ANSI_BLACK "%c" ANSI_RESET, c);
+            break;
+        case Wrong:
+            printf(ANSI_BACK_WHITE ANSI_GRAY "%c" ANSI_RESET, c);
+            break;
+        case Unknown:
+            printf("%c", c);
+            break;
+    }
+}
+
+/* Maps BOOK_FILE if it exists and was built for the current word lists */
+static void load_book(void)
+{
+    int fd = open(BOOK_FILE, O_RDONLY);
+
+    if (fd == -1)
+        return; /* No book, the solver will have to search */
+
+    struct stat statbuf;
+    if (fstat(fd, &statbuf) == -1) {
+        perror("fstat");
+        exit(1);
+    }
+
+    if ((size_t)statbuf.st_size != sizeof(struct Book)) {
+        close(fd);
+        return;
+    }
+
+    const struct Book *mapped = mmap(NULL, sizeof(*mapped), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (mapped == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+
+    mmap_register[BOOK_INDEX] = (struct Mmapped){
+        .ptr = (void *)mapped,
+        .len = sizeof(*mapped),
+    };
+
+    if (mapped->magic == BOOK_MAGIC && mapped->words_len == words.len && mapped->solutions_len == solutions.len) {
+        book = mapped;
+    }
+}
+
+static void *load_words(void *arg)
+{
+    (void)arg;
+
+    init_words();
+    load_book();
+
+    pthread_mutex_lock(&words_lock);
+    atomic_store_explicit(&words_ready, true, memory_order_release);
+    pthread_cond_broadcast(&words_cond);
+    pthread_mutex_unlock(&words_lock);
+
+    return NULL;
+}
+
+/* Waits for the loader and joins it, after this no other thread is running */
+static void words_finish(void)
+{
+    if (!words_loader_started)
+        return;
+
+    words_wait();
+    pthread_join(words_loader, NULL);
+    words_loader_started = false;
+}
+
+/* Loads and indexes words.txt (and the opening book which depends on it)
+ * in the background. Needs the solutions to be loaded already. */
+static void start_loading_words(void)
+{
+    if (pthread_create(&words_loader, NULL, load_words, NULL) != 0) {
+        /* Do it right here instead */
+        load_words(NULL);
+        return;
+    }
+
+    words_loader_started = true;
+}
+
+/* Computes the opening book for every strategy */
+static void compute_book(struct Book *out)
+{
+    *out = (struct Book){
+        .magic = BOOK_MAGIC,
+        .words_len = words.len,
+        .solutions_len = solutions.len,
+    };
+
+    for (size_t st = 0; st < STRATEGIES; st++) {
+        struct Solver s;
+
+        solver_init(&s);
+        long first = solver_best(&s, st);
+        solver_free(&s);
+
+        out->entries[st].first = first;
+
+        for (size_t p = 0; p < PATTERNS; p++) {
+            solver_init(&s);
+            solver_filter(&s, first, p);
+
+            long second = solver_best(&s, st);
+            out->entries[st].second[p] = second == -1 ? BOOK_NONE : second;
+
+            solver_free(&s);
+        }
+    }
+}
+
+/* Computes the opening book and writes it to BOOK_FILE */
+static void build_book(void)
+{
+    struct Book out;
+
+    compute_book(&out);
+
+    /* Write to a temporary file first so a running game never sees half a book */
+    static const char tmp[] = BOOK_FILE ".tmp";
+    FILE *f = fopen(tmp, "wb");
+    if (!f) {
+        perror(tmp);
+        exit(1);
+    }
+
+    if (fwrite(&out, sizeof(out), 1, f) != 1 || fclose(f) == EOF) {
+        perror(tmp);
+        exit(1);
+    }
+
+    if (rename(tmp, BOOK_FILE) == -1) {
+        perror("rename");
+        exit(1);
+    }
+}
+
+static bool has_repeated_letter(const char *word)
+{
+    uint32_t seen = 0;
+
+    for (size_t i = 0; i < LETTERS; i++) {
+        uint32_t bit = 1u << (word[i] - ASCII_A);
+        if (seen & bit)
+            return true;
+        seen |= bit;
+    }
+
+    return false;
+}
+
+/* Returns the book's move for the current position or -1 if it has none */
+static long book_lookup(const struct Solver *s, enum Strategy strategy)
+{
+    if (!book)
+        return -1;
+
+    const struct BookEntry *entry = &book->entries[strategy];
+
+    if (s->turn == 0)
+        return entry->first;
+
+    if (s->turn == 1 && s->first == entry->first && entry->second[s->first_pattern] != BOOK_NONE)
+        return entry->second[s->first_pattern];
+
+    return -1;
+}
+
+/* Writes the path of name inside the home directory to buf.
+ * Returns false if there is no home directory to use. */
+static bool home_path(char *buf, size_t buflen, const char *name)
+{
+    const char *home = getenv("HOME");
+
+    if (!home || !*home)
+        return false;
+
+    return (size_t)snprintf(buf, buflen, "%s/%s", home, name) < buflen;
+}
+
+static void stats_add(struct Stats *stats, const struct HistoryRecord *record)
+{
+    stats->played += 1;
+
+    if (record->won) {
+        stats->won += 1;
+        stats->streak += 1;
+        if (stats->streak > stats->max_streak)
+            stats->max_streak = stats->streak;
+        if (record->guesses >= 1 && record->guesses <= GUESSES)
+            stats->distribution[record->guesses - 1] += 1;
+    } else {
+        stats->streak = 0;
+    }
+}
+
+/* Returns the last checkpoint or an empty one if there is none */
+static struct StatsSnapshot read_snapshot(void)
+{
+    struct StatsSnapshot snapshot = { 0 };
+
+    char path[PATH_MAX];
+    if (!home_path(path, sizeof(path), SNAPSHOT_FILE))
+        return snapshot;
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+        return snapshot;
+
+    if (read(fd, &snapshot, sizeof(snapshot)) != sizeof(snapshot) || snapshot.magic != SNAPSHOT_MAGIC)
+        memset(&snapshot, 0, sizeof(snapshot));
+
+    close(fd);
+
+    return snapshot;
+}
+
+/* Replaces the snapshot atomically, a crash leaves either the old or the new one */
+static void write_snapshot(const struct StatsSnapshot *snapshot)
+{
+    char path[PATH_MAX];
+    char tmp[PATH_MAX];
+    if (!home_path(path, sizeof(path), SNAPSHOT_FILE) || !home_path(tmp, sizeof(tmp), SNAPSHOT_FILE ".tmp"))
+        return;
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        perror(tmp);
+        return;
+    }
+
+    /* The data has to be on disk before the rename makes it the snapshot */
+    bool ok = write(fd, snapshot, sizeof(*snapshot)) == sizeof(*snapshot) && fsync(fd) == 0;
+    close(fd);
+
+    if (!ok || rename(tmp, path) == -1) {
+        perror(path);
+        unlink(tmp);
+    }
+}
+
+/* Aggregates the history by mapping it, no parsing needed. Only the
+ * records after the last snapshot are replayed, and the snapshot is
+ * renewed once CHECKPOINT_INTERVAL records have piled up behind it. */
+static struct Stats read_stats(void)
+{
+    struct StatsSnapshot snapshot = read_snapshot();
+
+    char path[PATH_MAX];
+    if (!home_path(path, sizeof(path), HISTORY_FILE))
+        return snapshot.stats;
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+        return (struct Stats){ 0 }; /* No games played yet */
+
+    struct stat statbuf;
+    if (fstat(fd, &statbuf) == -1) {
+        perror("fstat");
+        exit(1);
+    }
+
+    /* A partially written trailing record is ignored */
+    size_t count = statbuf.st_size / sizeof(struct HistoryRecord);
+
+    /* The history was truncated or replaced, start over */
+    if (snapshot.records > count)
+        memset(&snapshot, 0, sizeof(snapshot));
+
+    if (snapshot.records == count) {
+        close(fd);
+        return snapshot.stats;
+    }
+
+    /* mmap offsets have to be page aligned */
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t begin = snapshot.records * sizeof(struct HistoryRecord);
+    size_t map_offset = begin / page * page;
+    size_t map_len = count * sizeof(struct HistoryRecord) - map_offset;
+
+    const char *mapped = mmap(NULL, map_len, PROT_READ, MAP_PRIVATE, fd, map_offset);
+    close(fd);
+
+    if (mapped == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+
+    const struct HistoryRecord *records = (const struct HistoryRecord *)(mapped + (begin - map_offset));
+
+    for (size_t i = 0; i < count - snapshot.records; i++) {
+        stats_add(&snapshot.stats, &records[i]);
+    }
+
+    munmap((void *)mapped, map_len);
+
+    if (count - snapshot.records >= CHECKPOINT_INTERVAL) {
+        snapshot.magic = SNAPSHOT_MAGIC;
+        snapshot.records = count;
+        write_snapshot(&snapshot);
+    }
+
+    return snapshot.stats;
+}
+
+/* Appends the finished game to the history. A single write of a
+ * fixed-size record with O_APPEND never interleaves with other games. */
+static void record_game(bool won, size_t guesses)
+{
+    char path[PATH_MAX];
+    if (!home_path(path, sizeof(path), HISTORY_FILE))
+        return;
+
+    int fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (fd == -1) {
+        perror(path);
+        return;
+    }
+
+    struct HistoryRecord record = {
+        .time = time(NULL),
+        .solution = solution_index,
+        .guesses = guesses,
+        .won = won,
+    };
+
+    struct stat statbuf;
+    bool ok = write(fd, &record, sizeof(record)) == sizeof(record) && fstat(fd, &statbuf) == 0;
+    if (!ok)
+        perror(path);
+
+    close(fd);
+
+    if (!ok)
+        return;
+
+    /* If the snapshot covers every game before this one, add it there
+     * directly. Otherwise another game ended at the same time or the
+     * snapshot is behind, and read_stats catches up later. */
+    size_t count = statbuf.st_size / sizeof(struct HistoryRecord);
+    struct StatsSnapshot snapshot = read_snapshot();
+
+    if (snapshot.records + 1 == count) {
+        stats_add(&snapshot.stats, &record);
+        snapshot.magic = SNAPSHOT_MAGIC;
+        snapshot.records = count;
+        write_snapshot(&snapshot);
+    }
+}
+
+static void print_stats(void)
+{
+    struct Stats stats = read_stats();
+
+    printf("Played: %zu  Win %%: %zu  Current streak: %zu  Max streak: %zu\n",
+           stats.played, stats.played ? stats.won * 100 / stats.played : 0,
+           stats.streak, stats.max_streak);
+
+    size_t max = 1;
+    for (size_t i = 0; i < GUESSES; i++) {
+        if (stats.distribution[i] > max)
+            max = stats.distribution[i];
+    }
+
+    printf("Guess distribution:\n");
+    for (size_t i = 0; i < GUESSES; i++) {
+        /* Scale the bars to at most 40 columns */
+        size_t bar = stats.distribution[i] * 40 / max;
+
+        printf("%zu: ", i + 1);
+        for (size_t j = 0; j < bar; j++) {
+            putchar('#');
+        }
+        printf(" %zu\n", stats.distribution[i]);
+    }
+}
+
+/* Writes the session with one write and a rename, so a crash
+ * leaves either the old or the new session behind. Only uses
+ * async-signal-safe functions so it can run on SIGHUP. */
+static void save_session(void)
+{
+    if (!session.magic || !*session_path)
+        return; /* No game in progress */
+
+    int fd = open(session_tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1)
+        return;
+
+    bool ok = write(fd, &session, sizeof(session)) == sizeof(session);
+    close(fd);
+
+    if (!ok || rename(session_tmp, session_path) == -1)
+        unlink(session_tmp);
+}
+
+/* The game is over, there is nothing left to resume */
+static void end_session(void)
+{
+    session.magic = 0;
+
+    if (*session_path)
+        unlink(session_path);
+}
+
+static void hangup(int sig)
+{
+    (void)sig;
+
+    save_session();
+    raw_mode_disable();
+    _exit(1);
+}
+
+static void session_add_guess(const char *guess)
+{
+    memcpy(session.guesses[session.guess_count++], guess, LETTERS);
+
+    for (size_t i = 0; i < ALPHABET_SZ; i++) {
+        session.alphabet[i] = alphabet[i].quality;
+    }
+
+    save_session();
+}
+
+/* Loads the saved session, if there is a valid one */
+static bool load_session(struct Session *out)
+{
+    int fd = open(session_path, O_RDONLY);
+    if (fd == -1)
+        return false;
+
+    bool ok = read(fd, out, sizeof(*out)) == sizeof(*out);
+    close(fd);
+
+    if (!ok || out->magic != SESSION_MAGIC || out->solution >= solutions.len || out->guess_count >= GUESSES)
+        return false;
+
+    for (size_t i = 0; i < out->guess_count; i++) {
+        for (size_t j = 0; j < LETTERS; j++) {
+            if (out->guesses[i][j] < 'a' || out->guesses[i][j] > 'z')
+                return false;
+        }
+    }
+
+    for (size_t i = 0; i < ALPHABET_SZ; i++) {
+        if (out->alphabet[i] > Unknown)
+            return false;
+    }
+
+    return true;
+}
+
+static void game_init(struct Game *game, size_t solution)
+{
+    *game = (struct Game){
+        .solution = solution,
+        .state = GamePlaying,
+    };
+}
+
+/* Counts guess, which is known to be LETTERS letters long */
+static void game_add(struct Game *game, const char *guess)
+{
+    uint8_t pattern = score_word(guess, solutions.array[game->solution].ptr);
+
+    memcpy(game->guesses[game->turn], guess, LETTERS);
+    game->patterns[game->turn++] = pattern;
+
+    if (pattern == 0)
+        game->state = GameWon;
+    else if (game->turn == GUESSES)
+        game->state = GameLost;
+}
+
+/* Moves the game on by one line of input */
+static enum GameEvent game_input(struct Game *game, const char *line)
+{
+    if (game->state != GamePlaying)
+        return GameOver;
+
+    size_t len = strlen(line);
+
+    if (len == 0)
+        return GameIgnored;
+
+    if (strcmp(line, "?") == 0)
+        return GameHintAsked;
+
+    if (len != LETTERS)
+        return GameWrongLength;
+
+    if (!valid(line))
+        return GameUnknownWord;
+
+    game_add(game, line);
+
+    return game->state == GamePlaying ? GameGuessed : GameOver;
+}
+
+/* Narrows s down to the candidates which fit the game so far */
+static void game_filter(const struct Game *game, struct Solver *s)
+{
+    for (size_t i = 0; i < game->turn; i++) {
+        long g = index_lookup(&words_index, game->guesses[i], LETTERS);
+        if (g != -1)
+            solver_filter(s, g, game->patterns[i]);
+    }
+}
+
+/* Sets up saving of the game in progress and resumes a saved one.
+ * Redraws the guesses of a resumed game without delay. */
+static void init_session(struct Game *game)
+{
+    if (!home_path(session_path, sizeof(session_path), SESSION_FILE)
+        || !home_path(session_tmp, sizeof(session_tmp), SESSION_FILE ".tmp")) {
+        *session_path = '\0';
+    }
+
+    struct sigaction action = { .sa_handler = hangup };
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGHUP, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    /* With -R the terminal driver still sends these for ^C and ^\ */
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGQUIT, &action, NULL);
+
+    struct Session saved;
+    if (!*session_path || !load_session(&saved)) {
+        session = (struct Session){
+            .magic = SESSION_MAGIC,
+            .solution = solution_index,
+        };
+        game_init(game, solution_index);
+        return;
+    }
+
+    session = saved;
+    solution_index = saved.solution;
+    solution = solutions.array[solution_index];
+    game_init(game, solution_index);
+
+    for (size_t i = 0; i < ALPHABET_SZ; i++) {
+        alphabet[i].quality = saved.alphabet[i];
+    }
+
+    for (size_t i = 0; i < saved.guess_count; i++) {
+        char guess[LETTERS + 1] = { 0 };
+        memcpy(guess, saved.guesses[i], LETTERS);
+
+        for (size_t j = 0; j < LETTERS; j++) {
+            print_qualified_char(guess[j], qualify_guess(guess, solution.ptr, j));
+        }
+        printf("\n");
+
+        game_add(game, guess);
+
+        y += 1;
+    }
+
+    /* Needs the words, so that has to wait for them */
+    words_wait();
+    game_filter(game, &solver);
+}
+
+/* Goes to the first line, erases it, prints msg, waits a moment
+ * and goes back to where the next input is */
+static void misinput(const char *msg)
+{
+    static const struct timespec nanosleep_request = { 0, 750000000 };
+
+    struct termios old = termios_disable_echo();
+
+    printf(ANSI_UP_N_LINE VT100_ERASE "%s", y, msg);
+    fflush(stdout);
+
+    nanosleep(&nanosleep_request, NULL);
+
+    printf("\r" VT100_ERASE ANSI_DOWN_N_LINE VT100_ERASE, y - 1);
+    fflush(stdout);
+
+    termios_restore(&old);
+}
+
+/* Redraws the guess typed so far, in red once no word starts with it */
+static void redraw_input(const char *line, size_t len)
+{
+    bool dead = false;
+
+    if (!(len == 1 && line[0] == '?')) {
+        for (size_t i = 0; i < len; i++) {
+            if (line[i] < 'a' || line[i] > 'z')
+                dead = true;
+        }
+
+        if (!dead) {
+            words_wait();
+            dead = !trie_has_prefix(&prefixes, line, len);
+        }
+    }
+
+    printf("\r" VT100_ERASE "%s%.*s" ANSI_RESET, dead ? ANSI_RED : "", (int)len, line);
+}
+
+/* Reads a guess key by key and echoes every letter straight into
+ * the board, marking it as soon as it cannot become a word anymore.
+ * Only letters, '?', backspace and enter are accepted.
+ * Returns a malloc'd line like readline does, or NULL on EOF. */
+/* Reads the next byte of an escape sequence. Gives up after
+ * ESCAPE_TIMEOUT tenths of a second, so that a lone escape does
+ * not swallow the key typed after it. */
+static bool read_escape_byte(unsigned char *c)
+{
+    struct termios wait = raw_saved;
+    wait.c_lflag &= ~(ICANON | ECHO);
+    wait.c_cc[VMIN] = 0;
+    wait.c_cc[VTIME] = ESCAPE_TIMEOUT;
+    tcsetattr(STDIN_FILENO, TCSANOW, &wait);
+
+    bool ok = read(STDIN_FILENO, c, 1) == 1;
+
+    wait.c_cc[VMIN] = 1;
+    wait.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSANOW, &wait);
+
+    return ok;
+}
+
+static char *read_line_raw(void)
+{
+    char *line = malloc(LETTERS + 1);
+    size_t len = 0;
+
+    /* Pressing tab repeatedly cycles through the completions */
+    uint16_t completions[COMPLETIONS];
+    size_t completion_count = 0;
+    size_t completion_next = 0;
+    bool completing = false;
+
+    for (;;) {
+        unsigned char c;
+        ssize_t n = read(STDIN_FILENO, &c, 1);
+
+        if (n <= 0 || (c == KEY_CTRL_D && len == 0)) {
+            free(line);
+            return NULL;
+        }
+
+        if (c != KEY_TAB)
+            completing = false;
+
+        if (c == KEY_TAB) {
+            if (!completing) {
+                completion_count = complete(&solver, line, len, completions);
+                completion_next = 0;
+                completing = true;
+            }
+
+            if (completion_count == 0) {
+                putchar('\a');
+            } else {
+                memcpy(line, solutions.array[completions[completion_next]].ptr, LETTERS);
+                len = LETTERS;
+                completion_next = (completion_next + 1) % completion_count;
+                redraw_input(line, len);
+            }
+        } else if (c == '\r' || c == '\n') {
+            printf("\n");
+            fflush(stdout);
+            break;
+        } else if (c == KEY_DELETE || c == KEY_BACKSPACE) {
+            if (len > 0) {
+                len -= 1;
+                redraw_input(line, len);
+            }
+        } else if (c == KEY_ESCAPE) {
+            /* Swallow escape sequences like the arrow keys */
+            if (read_escape_byte(&c) && c == '[') {
+                while (read_escape_byte(&c) && (c < 0x40 || c > 0x7e))
+                    ;
+            }
+        } else if (len < LETTERS && ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '?')) {
+            if (c >= 'A' && c <= 'Z')
+                c += 'a' - 'A';
+
+            line[len++] = c;
+            redraw_input(line, len);
+        }
+
+        fflush(stdout);
+    }
+
+    line[len] = '\0';
+
+    return line;
+}
+
+/* Searches for a hint the way the options ask for */
+static long solver_search(struct Solver *s, enum Strategy strategy)
+{
+    if (hint_budget)
+        return solver_best_within(s, strategy, hint_budget);
+
+    if (hint_sampled)
+        return solver_best_sampled(s, strategy, rand());
+
+    return solver_best(s, strategy);
+}
+
+/* Like misinput, but the message stays until it is overwritten */
+static void hint(void)
+{
+    char msg[BUF_SZ];
+
+    words_wait();
+
+    long best = book_lookup(&solver, Entropy);
+    if (best == -1)
+        best = solver_search(&solver, Entropy);
+
+    if (best == -1) {
+        snprintf(msg, sizeof(msg), "No hint available");
+    } else {
+        snprintf(msg, sizeof(msg), "Hint: "SV_Fmt" (%zu left)", SV_Arg(words.array[best]), solver.cand_len);
+    }
+
+    printf(ANSI_UP_N_LINE VT100_ERASE "%s\r" ANSI_DOWN_N_LINE VT100_ERASE, y, msg, y - 1);
+    fflush(stdout);
+}
+
+/* Prints the alphabet in the line under the current one and goes back up */
+static void reprint_alphabet(void)
+{
+    PROFILE_BEGIN(ProfReprintAlphabet);
+
+    printf("\n");
+    for (size_t i = 0; i < ALPHABET_SZ; i++) {
+        print_qualified_char(alphabet[i].chr, alphabet[i].quality);
+    }
+    printf(ANSI_UP_LINE);
+    fflush(stdout);
+
+    PROFILE_END(ProfReprintAlphabet);
+}
+
+/* Goes up line and reprints chars with colored quality
+ * and waits between each char. */
+static void color_word_and_update_alphabet(const char *guess)
+{
+    PROFILE_BEGIN(ProfColorWord);
+
+    struct termios old = termios_disable_echo();
+
+    printf(ANSI_UP_LINE);
+
+    for (size_t i = 0; i < LETTERS; i++) {
+        enum GuessQuality quality = qualify_guess(guess, solution.ptr, i);
+
+        print_qualified_char(guess[i], quality);
+        fflush(stdout);
+
+        if (overrides(alphabet[(int)guess[i] - ASCII_A].quality, quality)) {
+            alphabet[(int)guess[i] - ASCII_A].quality = quality; /* Update alphabet coloring accordingly (see overrides function) */
+        }
+
+        if (reveal_delay.tv_sec || reveal_delay.tv_nsec)
+            nanosleep(&reveal_delay, NULL);
+    }
+    printf("\n");
+
+    termios_restore(&old);
+
+    PROFILE_END(ProfColorWord);
+}
+
+static inline bool check_correct(const char *guess)
+{
+    return sv_cstr_eq(solution, guess);
+}
+
+/* Appends the finished game in the replay format */
+static void record_replay(void)
+{
+    char path[PATH_MAX];
+    if (!home_path(path, sizeof(path), REPLAY_FILE))
+        return;
+
+    char line[LETTERS + 1 + GUESSES * (LETTERS + 1) + 1];
+    size_t len = 0;
+
+    memcpy(line, solutions.array[session.solution].ptr, LETTERS);
+    len += LETTERS;
+
+    for (size_t i = 0; i < session.guess_count; i++) {
+        line[len++] = ' ';
+        memcpy(line + len, session.guesses[i], LETTERS);
+        len += LETTERS;
+    }
+    line[len++] = '\n';
+
+    int fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (fd == -1) {
+        perror(path);
+        return;
+    }
+
+    if (write(fd, line, len) != (ssize_t)len)
+        perror(path);
+
+    close(fd);
+}
+
+static bool parse_replay(sv line, struct Replay *out)
+{
+    sv word;
+
+    out->guess_count = 0;
+
+    if (!sv_chop_delim(' ', &line, &out->solution))
+        return false;
+
+    while (sv_chop_delim(' ', &line, &word)) {
+        if (word.len == 0)
+            continue; /* Repeated spaces */
+
+        if (out->guess_count == GUESSES)
+            return false;
+
+        out->guesses[out->guess_count++] = word;
+    }
+
+    return out->guess_count > 0;
+}
+
+/* Could the game have been played like this? Every guess has to be
+ * in the word list and the game has to end exactly when the solution
+ * was guessed or the guesses ran out. */
+static bool check_replay(const struct Replay *replay)
+{
+    if (index_lookup(&solutions_index, replay->solution.ptr, replay->solution.len) == -1)
+        return false;
+
+    for (size_t i = 0; i < replay->guess_count; i++) {
+        char guess[LETTERS + 1];
+
+        if (replay->guesses[i].len != LETTERS)
+            return false;
+
+        sv_to_cstr(replay->guesses[i], guess, sizeof(guess));
+
+        if (!valid(guess))
+            return false;
+
+        bool solved = score_word(guess, replay->solution.ptr) == 0;
+        bool last = i + 1 == replay->guess_count;
+
+        if (solved != last && !(last && replay->guess_count == GUESSES))
+            return false;
+    }
+
+    return true;
+}
+
+/* Plays a recorded game back through the normal rendering */
+static void render_replay(const struct Replay *replay)
+{
+    solution = replay->solution;
+    init_alphabet();
+    y = 3;
+
+    printf("\n\n");
+
+    bool solved = false;
+
+    for (size_t i = 0; i < replay->guess_count; i++) {
+        char guess[LETTERS + 1];
+        sv_to_cstr(replay->guesses[i], guess, sizeof(guess));
+
+        reprint_alphabet();
+        printf("%s\n", guess);
+
+        color_word_and_update_alphabet(guess);
+
+        if (check_correct(guess)) {
+            solved = true;
+            break;
+        }
+
+        printf(VT100_ERASE);
+
+        y += 1;
+    }
+
+    if (!solved)
+        printf("The word was: "SV_Fmt"\n", SV_Arg(solution));
+}
+
+struct InvalidGame {
+    size_t game; /* Number of the game within its shard */
+    sv line;
+};
+
+/* A part of a replay file, checked by its own thread. The counters
+ * are private to the thread and only merged once it is done. */
+struct VerifyShard {
+    pthread_t thread;
+    sv input;
+
+    size_t games;
+    size_t won;
+    struct InvalidGame *invalid;
+    size_t invalid_len;
+    size_t invalid_cap;
+};
+
+static void *verify_shard(void *arg)
+{
+    struct VerifyShard *shard = arg;
+
+    sv line;
+    while (sv_chop_delim('\n', &shard->input, &line)) {
+        struct Replay replay;
+
+        if (line.len == 0)
+            continue;
+
+        shard->games += 1;
+
+        if (parse_replay(line, &replay) && check_replay(&replay)) {
+            sv last = replay.guesses[replay.guess_count - 1];
+            shard->won += sv_eq(last, replay.solution);
+            continue;
+        }
+
+        if (shard->invalid_len == shard->invalid_cap) {
+            shard->invalid_cap = shard->invalid_cap ? shard->invalid_cap * 2 : 16;
+            shard->invalid = realloc(shard->invalid, shard->invalid_cap * sizeof(*shard->invalid));
+        }
+
+        shard->invalid[shard->invalid_len++] = (struct InvalidGame){
+            .game = shard->games,
+            .line = line,
+        };
+    }
+
+    return NULL;
+}
+
+/* Checks every game in contents, split across jobs threads at line
+ * boundaries. Prints the invalid games in file order and a summary. */
+static int verify_replays(sv contents, size_t jobs)
+{
+    struct VerifyShard *shards = calloc(jobs, sizeof(*shards));
+
+    const char *begin = contents.ptr;
+    const char *end = contents.ptr + contents.len;
+
+    for (size_t i = 0; i < jobs; i++) {
+        const char *split = i + 1 == jobs ? end : contents.ptr + contents.len / jobs * (i + 1);
+
+        if (split < begin)
+            split = begin;
+
+        /* Move the split past the end of the line it falls into */
+        while (split < end && split > begin && split[-1] != '\n') {
+            split++;
+        }
+
+        shards[i].input = sv_from_data(begin, split - begin);
+        begin = split;
+
+        if (pthread_create(&shards[i].thread, NULL, verify_shard, &shards[i]) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+
+    size_t games = 0;
+    size_t won = 0;
+    size_t invalid = 0;
+
+    for (size_t i = 0; i < jobs; i++) {
+        pthread_join(shards[i].thread, NULL);
+
+        for (size_t j = 0; j < shards[i].invalid_len; j++) {
+            const struct InvalidGame *bad = &shards[i].invalid[j];
+            printf("Invalid game %zu: "SV_Fmt"\n", games + bad->game, SV_Arg(bad->line));
+        }
+
+        games += shards[i].games;
+        won += shards[i].won;
+        invalid += shards[i].invalid_len;
+
+        free(shards[i].invalid);
+    }
+
+    free(shards);
+
+    printf("%zu games, %zu invalid, %zu won\n", games, invalid, won);
+
+    return invalid != 0;
+}
+
+/* Renders every game in file or, if check is set, only validates
+ * them using jobs threads and prints the invalid games */
+static int replay_file(const char *file, bool check, size_t jobs)
+{
+    sv contents = map_file(file);
+    mmap_register[REPLAY_INDEX] = (struct Mmapped){
+        .ptr = (void *)contents.ptr,
+        .len = contents.len,
+    };
+
+    if (check)
+        return verify_replays(contents, jobs);
+
+    int ret = 0;
+
+    sv line;
+    while (sv_chop_delim('\n', &contents, &line)) {
+        struct Replay replay;
+
+        if (line.len == 0)
+            continue;
+
+        if (parse_replay(line, &replay) && check_replay(&replay)) {
+            render_replay(&replay);
+        } else {
+            fprintf(stderr, "Skipping invalid game: "SV_Fmt"\n", SV_Arg(line));
+            ret = 1;
+        }
+    }
+
+    return ret;
+}
+
+/* Called at exit. It is good practice to clean up after yourself. */
+static void cleanup(void)
+{
+    save_session();
+    raw_mode_disable();
+
+    /* Unless the loader itself is exiting, let it finish before freeing */
+    if (words_loader_started && !pthread_equal(pthread_self(), words_loader))
+        words_finish();
+
+#ifdef CLIDLE_PROFILE
+    profile_dump();
+#endif
+
+    trace_write();
+
+    free(words.array);
+    free(solutions.array);
+    index_free(&words_index);
+    index_free(&solutions_index);
+    trie_free(&prefixes);
+    free(packed_words);
+    solver_free(&solver);
+
+    for (size_t i = 0; i < MMAPPED_FILES; i++) {
+        if (!mmap_register[i].ptr)
+            continue; /* Optional file which was not mapped */
+
+        if (munmap(mmap_register[i].ptr, mmap_register[i].len) == -1) {
+            perror("munmap");
+        }
+    }
+}
+
+/* Plays one game on the terminal */
+static int play(void)
+{
+#ifndef NO_READLINE
+    /* Readline init */
+    rl_editing_mode = 0; /* Put readline into vi-mode */
+    rl_attempted_completion_function = complete_readline;
+    rl_sort_completion_matches = 0; /* Keep them ordered by rating */
+    /* Cycle through the completions in place, a list would mess up the board */
+    rl_bind_key_in_map('\t', rl_menu_complete, vi_insertion_keymap);
+    rl_bind_key_in_map('\t', rl_menu_complete, emacs_standard_keymap);
+#endif
+
+    printf("\n\n");
+
+    /* Only once init_session handles the signals which would
+     * otherwise leave the terminal in raw mode */
+    struct Game game;
+    init_session(&game);
+    start_rating(&solver);
+
+    if (raw_input)
+        raw_mode_enable();
+
+    while (game.state == GamePlaying) {
+        uint64_t turn = trace_begin();
+        size_t guess = game.turn + 1;
+
+        uint64_t phase = trace_begin();
+        reprint_alphabet();
+        trace_end("render", phase);
+
+        phase = trace_begin();
+#ifdef NO_READLINE
+        char *line = read_line_raw();
+#else
+        char *line = raw_input ? read_line_raw() : readline("");
+#endif
+        trace_end("input", phase);
+
+        if (!line) {
+            trace_end_turn(turn, guess);
+            return 0; /* EOF was typed, exit */
+        }
+
+        line[strcspn(line, "\n")] = '\0';
+
+        phase = trace_begin();
+        enum GameEvent event = game_input(&game, line);
+        trace_end("validate and score", phase);
+
+        switch (event) {
+            case GameIgnored:
+                break;
+            case GameHintAsked:
+                /* Asking for a hint does not count as guess */
+                phase = trace_begin();
+                hint();
+                trace_end("hint", phase);
+                break;
+            case GameWrongLength:
+                misinput("Wrong length");
+                break;
+            case GameUnknownWord: {
+                char msg[BUF_SZ];
+                not_in_word_list(line, msg, sizeof(msg));
+                misinput(msg);
+                break;
+            }
+            case GameGuessed:
+            case GameOver:
+                phase = trace_begin();
+                color_word_and_update_alphabet(line);
+                trace_end("animate", phase);
+
+                session_add_guess(line);
+
+                phase = trace_begin();
+                solver_filter(&solver, word_index(line), game.patterns[game.turn - 1]);
+                trace_end("filter candidates", phase);
+
+                if (event == GameGuessed) {
+                    /* Clear the now current line that has the alphabet on it */
+                    printf(VT100_ERASE);
+
+                    y += 1;
+                }
+                break;
+        }
+
+        free(line);
+
+        trace_end_turn(turn, guess);
+    }
+
+    record_replay();
+    end_session();
+    record_game(game.state == GameWon, game.turn);
+
+    if (game.state == GameLost)
+        printf("The word was: "SV_Fmt"\n", SV_Arg(solution));
+
+    return 0;
+}
+
+static bool zygote_listen(const char *path, int *out)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "%s: Socket path too long\n", path);
+        return false;
+    }
+    strcpy(addr.sun_path, path);
+
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock == -1) {
+        perror("socket");
+        return false;
+    }
+
+    unlink(path); /* Left over from an earlier zygote */
+
+    /* Only our own user may connect: games write to our home directory */
+    mode_t old_mask = umask(077);
+    int bound = bind(sock, (struct sockaddr *)&addr, sizeof(addr));
+    umask(old_mask);
+
+    if (bound == -1 || listen(sock, SOMAXCONN) == -1) {
+        perror(path);
+        close(sock);
+        return false;
+    }
+
+    *out = sock;
+
+    return true;
+}
+
+/* Receives the client's standard file descriptors */
+static bool zygote_receive(int conn, int fds[ZYGOTE_FDS])
+{
+    union {
+        char buf[CMSG_SPACE(ZYGOTE_FDS * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+
+    char byte;
+    struct iovec iov = { .iov_base = &byte, .iov_len = 1 };
+    struct msghdr msg = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control.buf,
+        .msg_controllen = sizeof(control.buf),
+    };
+
+    ssize_t n = recvmsg(conn, &msg, 0);
+    if (n <= 0)
+        return false;
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS
+        && cmsg->cmsg_len == CMSG_LEN(ZYGOTE_FDS * sizeof(int)) && !(msg.msg_flags & MSG_CTRUNC)) {
+        memcpy(fds, CMSG_DATA(cmsg), ZYGOTE_FDS * sizeof(int));
+        return true;
+    }
+
+    /* Whatever did arrive is ours now and has to be closed */
+    for (; cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+            continue;
+
+        size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (size_t i = 0; i < count; i++) {
+            int fd;
+            memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(fd));
+            close(fd);
+        }
+    }
+
+    return false;
+}
+
+/* Serves games on the socket at path. Everything is loaded once up
+ * front and every connection gets a forked copy of this process, which
+ * takes over the client's terminal and plays one game on it. */
+static int zygote(const char *path)
+{
+    /* The children have to start out with everything loaded, and fork
+     * only copies the calling thread */
+    words_finish();
+
+    int sock;
+    if (!zygote_listen(path, &sock))
+        return 1;
+
+    /* Let the kernel reap finished games */
+    struct sigaction ignore = { .sa_handler = SIG_IGN };
+    sigemptyset(&ignore.sa_mask);
+    sigaction(SIGCHLD, &ignore, NULL);
+
+    for (;;) {
+        int conn = accept(sock, NULL, NULL);
+        if (conn == -1) {
+            if (errno != EINTR)
+                perror("accept");
+            continue;
+        }
+
+        int fds[ZYGOTE_FDS];
+
+        if (!zygote_receive(conn, fds)) {
+            close(conn);
+            continue;
+        }
+
+        fflush(stdout);
+        fflush(stderr);
+
+        pid_t pid = fork();
+
+        if (pid == 0) {
+            close(sock);
+
+            for (int fd = 0; fd < ZYGOTE_FDS; fd++) {
+                dup2(fds[fd], fd);
+                close(fds[fd]);
+            }
+
+            /* The zygote's output may have gone to a file */
+            setvbuf(stdout, NULL, _IOLBF, 0);
+
+            srand(time(NULL) ^ getpid());
+            choose_solution();
+
+            /* conn is left open until the game exits, so the
+             * client can tell when it is over */
+            exit(play());
+        }
+
+        if (pid == -1)
+            perror("fork");
+
+        for (int fd = 0; fd < ZYGOTE_FDS; fd++) {
+            close(fds[fd]);
+        }
+        close(conn);
+    }
+}
+
+/* Hands this terminal to the zygote at path and waits for the game to end */
+static int zygote_client(const char *path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "%s: Socket path too long\n", path);
+        return 1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock == -1 || connect(sock, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+        perror(path);
+        return 1;
+    }
+
+    union {
+        char buf[CMSG_SPACE(ZYGOTE_FDS * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+
+    /* Always send at least one byte, the fds cannot travel alone */
+    struct iovec iov = { .iov_base = "", .iov_len = 1 };
+    struct msghdr msg = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control.buf,
+        .msg_controllen = sizeof(control.buf),
+    };
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(ZYGOTE_FDS * sizeof(int));
+
+    int fds[ZYGOTE_FDS] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    if (sendmsg(sock, &msg, 0) == -1) {
+        perror("sendmsg");
+        return 1;
+    }
+
+    for (;;) {
+        char c;
+        ssize_t n = read(sock, &c, 1);
+
+        if (n == 0 || (n == -1 && errno != EINTR))
+            break;
+    }
+
+    close(sock);
+
+    return 0;
+}
+
+/* Parses feedback like "gybxx": g for green, y for yellow and
+ * b, x or . for gray, one letter per letter of the guess */
+static bool parse_feedback(sv text, uint8_t *out)
+{
+    if (text.len != LETTERS)
+        return false;
+
+    uint8_t pattern = 0;
+    for (size_t i = LETTERS; i-- > 0;) {
+        enum GuessQuality quality;
+
+        switch (text.ptr[i]) {
+            case 'g':
+                quality = RightPlace;
+                break;
+            case 'y':
+                quality = WrongPlace;
+                break;
+            case 'b':
+            case 'x':
+            case '.':
+                quality = Wrong;
+                break;
+            default:
+                return false;
+        }
+
+        pattern = pattern * 3 + quality;
+    }
+
+    *out = pattern;
+
+    return true;
+}
+
+/* Writes the colors of pattern like parse_feedback reads them */
+static void format_feedback(uint8_t pattern, char out[LETTERS])
+{
+    for (size_t i = 0; i < LETTERS; i++) {
+        out[i] = "gyx"[pattern % 3];
+        pattern /= 3;
+    }
+}
+
+/* Prints the remaining candidates, if there are few, and the best guess */
+static void assistant_advise(void)
+{
+    if (solver.cand_len == 0) {
+        printf("No solution fits that feedback, enter an empty line to start over\n");
+    } else if (solver.cand_len <= ASSISTANT_LIST_MAX) {
+        printf("%zu left:", solver.cand_len);
+        for (size_t i = 0; i < solver.cand_len; i++) {
+            printf(" "SV_Fmt, SV_Arg(solutions.array[solver.cand[i]]));
+        }
+        printf("\n");
+    } else {
+        printf("%zu left\n", solver.cand_len);
+    }
+
+    /* The book was built with qualify_guess's rule, which only differs
+     * from Wordle's for repeated letters. */
+    long best = -1;
+    if (solver.turn < 2 && book && !has_repeated_letter(words.array[book->entries[Entropy].first].ptr))
+        best = book_lookup(&solver, Entropy);
+    if (best == -1)
+        best = solver_search(&solver, Entropy);
+
+    if (best != -1)
+        printf("Best guess: "SV_Fmt"\n", SV_Arg(words.array[best]));
+
+    fflush(stdout);
+}
+
+/* Helps with a game played elsewhere: reads lines like "crane gybxx"
+ * with a guess and the feedback it got and answers with what is left
+ * and the best next guess. An empty line starts a new game. */
+static int assistant(void)
+{
+    words_wait();
+    wordle_rules = true;
+
+    assistant_advise();
+
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t n;
+
+    while ((n = getline(&line, &cap, stdin)) != -1) {
+        sv input = sv_from_data(line, n);
+        sv guess_sv, feedback_sv;
+
+        if (input.len && input.ptr[input.len - 1] == '\n')
+            input.len -= 1;
+
+        if (input.len == 0) {
+            solver_free(&solver);
+            solver_init(&solver);
+            assistant_advise();
+            continue;
+        }
+
+        char guess[LETTERS + 1];
+        uint8_t pattern;
+
+        if (!sv_chop_delim(' ', &input, &guess_sv) || !sv_chop_delim(' ', &input, &feedback_sv)
+            || guess_sv.len != LETTERS || !parse_feedback(feedback_sv, &pattern)) {
+            printf("Expected a guess and its feedback, like: crane gybxx\n");
+            fflush(stdout);
+            continue;
+        }
+
+        sv_to_cstr(guess_sv, guess, sizeof(guess));
+
+        long g = word_index(guess);
+        if (g == -1) {
+            printf("Not in word list\n");
+            fflush(stdout);
+            continue;
+        }
+
+        solver_filter(&solver, g, pattern);
+        assistant_advise();
+    }
+
+    free(line);
+
+    return 0;
+}
+
+/* How well a first guess splits the solutions */
+struct GuessReport {
+    uint16_t word;
+    double entropy; /* Bits of information expected from the feedback */
+    double expected; /* Expected number of solutions left */
+    uint16_t worst; /* Solutions left in the worst case */
+};
+
+struct ReportShard {
+    pthread_t thread;
+    struct GuessReport *reports;
+    size_t begin;
+    size_t end;
+};
+
+static void *report_shard(void *arg)
+{
+    struct ReportShard *shard = arg;
+
+    for (size_t g = shard->begin; g < shard->end; g++) {
+        uint16_t buckets[PATTERNS] = { 0 };
+
+        for (size_t j = 0; j < solutions.len; j++) {
+            buckets[score_word(words.array[g].ptr, solutions.array[j].ptr)] += 1;
+        }
+
+        double squares = 0;
+        for (size_t p = 0; p < PATTERNS; p++) {
+            squares += (double)buckets[p] * buckets[p];
+        }
+
+        shard->reports[g] = (struct GuessReport){
+            .word = g,
+            .entropy = -rate_split(buckets, solutions.len, Entropy),
+            .expected = squares / solutions.len,
+            .worst = rate_split(buckets, solutions.len, Minimax),
+        };
+    }
+
+    return NULL;
+}
+
+static int compare_reports(const void *a, const void *b)
+{
+    const struct GuessReport *x = a;
+    const struct GuessReport *y = b;
+
+    if (x->entropy != y->entropy)
+        return (x->entropy < y->entropy) - (x->entropy > y->entropy);
+
+    return (x->word > y->word) - (x->word < y->word);
+}
+
+/* Rates every word in words.txt as a first guess against all solutions,
+ * split across jobs threads, and prints the table best first */
+static int report_first_guesses(size_t jobs)
+{
+    struct GuessReport *reports = malloc(words.len * sizeof(*reports));
+    struct ReportShard *shards = calloc(jobs, sizeof(*shards));
+
+    for (size_t i = 0; i < jobs; i++) {
+        shards[i] = (struct ReportShard){
+            .reports = reports,
+            .begin = words.len * i / jobs,
+            .end = words.len * (i + 1) / jobs,
+        };
+
+        if (pthread_create(&shards[i].thread, NULL, report_shard, &shards[i]) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+
+    for (size_t i = 0; i < jobs; i++) {
+        pthread_join(shards[i].thread, NULL);
+    }
+
+    free(shards);
+
+    qsort(reports, words.len, sizeof(*reports), compare_reports);
+
+    printf("%6s %-6s %8s %10s %6s\n", "rank", "word", "entropy", "expected", "worst");
+    for (size_t i = 0; i < words.len; i++) {
+        printf("%6zu "SV_Fmt" %8.4f %10.2f %6u\n", i + 1, SV_Arg(words.array[reports[i].word]),
+               reports[i].entropy, reports[i].expected, reports[i].worst);
+    }
+
+    free(reports);
+
+    return 0;
+}
+
+/* A way of playing: picks the next guess (an index into words.txt) given
+ * the guesses and patterns so far, s holds the candidates left. Returns
+ * -1 to give up. setup is optional and run once before any game.
+ * Bots loaded with -P have plugin set instead of guess. */
+struct Bot {
+    const char *name;
+    void (*setup)(size_t jobs);
+    long (*guess)(struct Solver *s, const uint16_t *guesses, const uint8_t *patterns);
+    const struct clidle_bot *plugin;
+};
+
+/* Entropy's choice for every position it can reach, computed once up
+ * front so that a move is a walk down the tree instead of a search */
+struct TreeNode {
+    uint16_t guess;
+    struct TreeNode *next[PATTERNS]; /* NULL if the pattern cannot occur */
+};
+
+static struct TreeNode *tree;
+
+static struct TreeNode *tree_build(struct Solver *s)
+{
+    struct TreeNode *node = calloc(1, sizeof(*node));
+
+    long g = book_lookup(s, Entropy);
+    if (g == -1)
+        g = solver_best(s, Entropy);
+
+    node->guess = g;
+
+    if (s->turn + 1 >= TOURNAMENT_LIMIT)
+        return node;
+
+    bool seen[PATTERNS] = { false };
+    for (size_t j = 0; j < s->cand_len; j++) {
+        seen[score_word(words.array[g].ptr, solutions.array[s->cand[j]].ptr)] = true;
+    }
+
+    /* Pattern 0 means solved, nothing left to decide */
+    for (size_t p = 1; p < PATTERNS; p++) {
+        if (!seen[p])
+            continue;
+
+        struct Solver child;
+        solver_copy(&child, s);
+        solver_filter(&child, g, p);
+        node->next[p] = tree_build(&child);
+        solver_free(&child);
+    }
+
+    return node;
+}
+
+static void tree_free(struct TreeNode *node)
+{
+    if (!node)
+        return;
+
+    for (size_t p = 0; p < PATTERNS; p++) {
+        tree_free(node->next[p]);
+    }
+
+    free(node);
+}
+
+struct TreeShard {
+    pthread_t thread;
+    const struct Solver *root;
+    _Atomic size_t *next_pattern;
+};
+
+/* Builds the subtrees below the root, one pattern at a time */
+static void *tree_shard(void *arg)
+{
+    struct TreeShard *shard = arg;
+
+    for (;;) {
+        size_t p = atomic_fetch_add(shard->next_pattern, 1);
+        if (p >= PATTERNS)
+            break;
+
+        struct Solver child;
+        solver_copy(&child, shard->root);
+        solver_filter(&child, tree->guess, p);
+
+        if (p != 0 && child.cand_len)
+            tree->next[p] = tree_build(&child);
+
+        solver_free(&child);
+    }
+
+    return NULL;
+}
+
+static void tree_setup(size_t jobs)
+{
+    struct Solver root;
+    solver_init(&root);
+
+    long first = book_lookup(&root, Entropy);
+    if (first == -1)
+        first = solver_best(&root, Entropy);
+
+    tree = calloc(1, sizeof(*tree));
+    tree->guess = first;
+
+    _Atomic size_t next_pattern = 0;
+    struct TreeShard *shards = calloc(jobs, sizeof(*shards));
+
+    for (size_t i = 0; i < jobs; i++) {
+        shards[i] = (struct TreeShard){
+            .root = &root,
+            .next_pattern = &next_pattern,
+        };
+
+        if (pthread_create(&shards[i].thread, NULL, tree_shard, &shards[i]) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+
+    for (size_t i = 0; i < jobs; i++) {
+        pthread_join(shards[i].thread, NULL);
+    }
+
+    free(shards);
+    solver_free(&root);
+}
+
+static long bot_tree(struct Solver *s, const uint16_t *guesses, const uint8_t *patterns)
+{
+    (void)guesses;
+
+    const struct TreeNode *node = tree;
+    for (size_t t = 0; t < s->turn && node; t++) {
+        node = node->next[patterns[t]];
+    }
+
+    return node ? node->guess : -1;
+}
+
+static long bot_entropy(struct Solver *s, const uint16_t *guesses, const uint8_t *patterns)
+{
+    (void)guesses;
+    (void)patterns;
+
+    long best = book_lookup(s, Entropy);
+
+    return best != -1 ? best : solver_best(s, Entropy);
+}
+
+static long bot_minimax(struct Solver *s, const uint16_t *guesses, const uint8_t *patterns)
+{
+    (void)guesses;
+    (void)patterns;
+
+    long best = book_lookup(s, Minimax);
+
+    return best != -1 ? best : solver_best(s, Minimax);
+}
+
+/* Guesses the candidate with the best letter_score, no search at all */
+static long bot_frequency(struct Solver *s, const uint16_t *guesses, const uint8_t *patterns)
+{
+    (void)guesses;
+    (void)patterns;
+
+    uint32_t contained[ALPHABET_SZ];
+    letter_counts(s, contained);
+
+    long best = -1;
+    uint32_t best_score = 0;
+
+    for (size_t j = 0; j < s->cand_len; j++) {
+        uint32_t score = letter_score(s, contained, solutions.array[s->cand[j]].ptr);
+
+        if (best == -1 || score > best_score) {
+            best = s->cand[j];
+            best_score = score;
+        }
+    }
+
+    if (best == -1)
+        return -1;
+
+    return index_lookup(&words_index, solutions.array[best].ptr, LETTERS);
+}
+
+static const struct Bot bots[] = {
+    { "entropy", NULL, bot_entropy, NULL },
+    { "minimax", NULL, bot_minimax, NULL },
+    { "frequency", NULL, bot_frequency, NULL },
+    { "tree", tree_setup, bot_tree, NULL },
+};
+
+/* Opens the plugin at path and checks that it speaks our ABI.
+ * It is only initialized once the words are loaded. */
+static void load_plugin(const char *path)
+{
+    if (plugins_len == PLUGINS_MAX) {
+        fprintf(stderr, "%s: At most %d plugins can be loaded\n", path, PLUGINS_MAX);
+        exit(1);
+    }
+
+    void *handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        fprintf(stderr, "%s\n", dlerror());
+        exit(1);
+    }
+
+    const struct clidle_bot *bot = dlsym(handle, "clidle_bot");
+    if (!bot) {
+        fprintf(stderr, "%s: No clidle_bot symbol\n", path);
+        exit(1);
+    }
+
+    if (bot->abi != CLIDLE_BOT_ABI) {
+        fprintf(stderr, "%s: Built for plugin ABI %d, expected %d\n", path, bot->abi, CLIDLE_BOT_ABI);
+        exit(1);
+    }
+
+    if (!bot->guess) {
+        fprintf(stderr, "%s: clidle_bot has no guess function\n", path);
+        exit(1);
+    }
+
+    plugins[plugins_len++] = (struct Plugin){
+        .handle = handle,
+        .bot = bot,
+        .name = bot->name ? bot->name : path,
+    };
+}
+
+/* Hands the word lists to every plugin */
+static void init_plugins(void)
+{
+    static const char **word_ptrs;
+    static const char **solution_ptrs;
+    static struct clidle_bot_words lists;
+
+    if (!plugins_len || word_ptrs)
+        return;
+
+    word_ptrs = malloc(words.len * sizeof(*word_ptrs));
+    for (size_t i = 0; i < words.len; i++) {
+        word_ptrs[i] = words.array[i].ptr;
+    }
+
+    solution_ptrs = malloc(solutions.len * sizeof(*solution_ptrs));
+    for (size_t i = 0; i < solutions.len; i++) {
+        solution_ptrs[i] = solutions.array[i].ptr;
+    }
+
+    lists = (struct clidle_bot_words){
+        .words = word_ptrs,
+        .words_len = words.len,
+        .solutions = solution_ptrs,
+        .solutions_len = solutions.len,
+    };
+
+    for (size_t i = 0; i < plugins_len; i++) {
+        if (plugins[i].bot->init && plugins[i].bot->init(&lists) != 0) {
+            fprintf(stderr, "%s: Initialization failed\n", plugins[i].name);
+            exit(1);
+        }
+        plugins[i].ready = true;
+    }
+}
+
+static void unload_plugins(void)
+{
+    for (size_t i = 0; i < plugins_len; i++) {
+        if (plugins[i].ready && plugins[i].bot->fini)
+            plugins[i].bot->fini();
+
+        dlclose(plugins[i].handle);
+    }
+
+    plugins_len = 0;
+}
+
+struct TournamentShard {
+    pthread_t thread;
+    const struct Bot *bot;
+    size_t begin;
+    size_t end;
+
+    uint64_t guesses;
+    uint64_t moves;
+    uint64_t time_us; /* Spent in the bot choosing moves */
+    size_t failed;
+    size_t worst;
+};
+
+struct TournamentGame {
+    struct Solver s;
+    size_t solution;
+    uint16_t guesses[TOURNAMENT_LIMIT];
+    uint8_t patterns[TOURNAMENT_LIMIT];
+    bool solved;
+    bool over;
+};
+
+/* Asks the bot for the next guess in each of the n games */
+static void tournament_guess(const struct Bot *bot, struct TournamentGame **games, size_t n, long *guesses)
+{
+    if (!bot->plugin) {
+        for (size_t i = 0; i < n; i++) {
+            guesses[i] = bot->guess(&games[i]->s, games[i]->guesses, games[i]->patterns);
+        }
+        return;
+    }
+
+    struct clidle_bot_game states[TOURNAMENT_BATCH];
+
+    for (size_t i = 0; i < n; i++) {
+        states[i] = (struct clidle_bot_game){
+            .turn = games[i]->s.turn,
+            .guesses = games[i]->guesses,
+            .patterns = games[i]->patterns,
+            .candidates = games[i]->s.cand,
+            .candidates_len = games[i]->s.cand_len,
+        };
+    }
+
+    bot->plugin->guess(states, n, guesses);
+}
+
+/* Plays the bot against the solutions from begin to end,
+ * TOURNAMENT_BATCH games at a time, one turn of each after another */
+static void *tournament_shard(void *arg)
+{
+    struct TournamentShard *shard = arg;
+    struct TournamentGame batch[TOURNAMENT_BATCH];
+
+    for (size_t first = shard->begin; first < shard->end; first += TOURNAMENT_BATCH) {
+        size_t n = shard->end - first < TOURNAMENT_BATCH ? shard->end - first : TOURNAMENT_BATCH;
+
+        for (size_t i = 0; i < n; i++) {
+            batch[i] = (struct TournamentGame){ .solution = first + i };
+            solver_init(&batch[i].s);
+        }
+
+        for (;;) {
+            struct TournamentGame *playing[TOURNAMENT_BATCH];
+            long guesses[TOURNAMENT_BATCH];
+            size_t active = 0;
+
+            for (size_t i = 0; i < n; i++) {
+                if (!batch[i].over)
+                    playing[active++] = &batch[i];
+            }
+
+            if (active == 0)
+                break;
+
+            uint64_t start = monotonic_us();
+            tournament_guess(shard->bot, playing, active, guesses);
+            shard->time_us += monotonic_us() - start;
+            shard->moves += active;
+
+            for (size_t i = 0; i < active; i++) {
+                struct TournamentGame *game = playing[i];
+                long g = guesses[i];
+
+                if (g < 0 || (size_t)g >= words.len) {
+                    game->over = true; /* Gave up */
+                    continue;
+                }
+
+                uint8_t pattern = score_word(words.array[g].ptr, solutions.array[game->solution].ptr);
+
+                game->guesses[game->s.turn] = g;
+                game->patterns[game->s.turn] = pattern;
+                solver_filter(&game->s, g, pattern);
+
+                game->solved = pattern == 0;
+                game->over = game->solved || game->s.turn == TOURNAMENT_LIMIT;
+            }
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            size_t turns = batch[i].s.turn;
+
+            shard->guesses += turns;
+            if (!batch[i].solved || turns > GUESSES)
+                shard->failed += 1;
+            if (turns > shard->worst)
+                shard->worst = turns;
+
+            solver_free(&batch[i].s);
+        }
+    }
+
+    return NULL;
+}
+
+/* Plays every bot against every solution, split across jobs threads,
+ * and prints how each of them did */
+static int tournament(size_t jobs)
+{
+    static struct Book computed;
+
+    if (!book) {
+        fprintf(stderr, "No opening book, computing it first (see make book)\n");
+        compute_book(&computed);
+        book = &computed;
+    }
+
+    struct Bot contestants[sizeof(bots) / sizeof(*bots) + PLUGINS_MAX];
+    size_t contestants_len = 0;
+
+    for (size_t b = 0; b < sizeof(bots) / sizeof(*bots); b++) {
+        contestants[contestants_len++] = bots[b];
+    }
+
+    for (size_t i = 0; i < plugins_len; i++) {
+        contestants[contestants_len++] = (struct Bot){
+            .name = plugins[i].name,
+            .plugin = plugins[i].bot,
+        };
+    }
+
+    printf("%-10s %8s %8s %6s %10s %10s\n", "strategy", "average", "failed", "worst", "us/move", "setup ms");
+
+    for (size_t b = 0; b < contestants_len; b++) {
+        const struct Bot *bot = &contestants[b];
+
+        uint64_t setup = monotonic_us();
+        if (bot->setup)
+            bot->setup(jobs);
+        else if (bot->plugin)
+            init_plugins();
+        setup = monotonic_us() - setup;
+
+        struct TournamentShard *shards = calloc(jobs, sizeof(*shards));
+
+        for (size_t i = 0; i < jobs; i++) {
+            shards[i] = (struct TournamentShard){
+                .bot = bot,
+                .begin = solutions.len * i / jobs,
+                .end = solutions.len * (i + 1) / jobs,
+            };
+
+            if (pthread_create(&shards[i].thread, NULL, tournament_shard, &shards[i]) != 0) {
+                perror("pthread_create");
+                exit(1);
+            }
+        }
+
+        struct TournamentShard total = { 0 };
+
+        for (size_t i = 0; i < jobs; i++) {
+            pthread_join(shards[i].thread, NULL);
+
+            total.guesses += shards[i].guesses;
+            total.moves += shards[i].moves;
+            total.time_us += shards[i].time_us;
+            total.failed += shards[i].failed;
+            if (shards[i].worst > total.worst)
+                total.worst = shards[i].worst;
+        }
+
+        free(shards);
+
+        printf("%-10s %8.4f %7.2f%% %6zu %10.1f %10.1f\n", bot->name,
+               (double)total.guesses / solutions.len, 100.0 * total.failed / solutions.len, total.worst,
+               total.moves ? (double)total.time_us / total.moves : 0.0, setup / 1000.0);
+        fflush(stdout);
+    }
+
+    tree_free(tree);
+    tree = NULL;
+
+    unload_plugins();
+
+    return 0;
+}
+
+/* The arena talks to bot programs line by line over their stdin and
+ * stdout. It starts every game with "new" and the bot answers with a
+ * guess, to which the reply is the colors ("g", "y" or "x" for every
+ * letter, e.g. "gyxxx") or "invalid" if it is not a word. The bot
+ * answers every such line with its next guess. Once the game is won or
+ * lost the reply is "over" and the solution instead, and the next game
+ * starts with "new". At the end, stdin is closed. */
+
+/* An external bot program and how it did in the arena */
+struct ArenaBot {
+    const char *program;
+    size_t next_solution; /* Next game to hand out */
+
+    size_t games;
+    uint64_t guesses;
+    uint64_t moves;
+    uint64_t time_us; /* Spent waiting for guesses */
+    size_t failed;
+    size_t invalid;
+    size_t crashed;
+};
+
+/* One running copy of a bot program, playing one game at a time */
+struct ArenaProcess {
+    struct ArenaBot *bot;
+    pid_t pid;
+    int to; /* The bot's stdin, -1 once closed */
+    int from; /* The bot's stdout, -1 once the bot is gone */
+    char buf[BUF_SZ];
+    size_t buf_len;
+
+    size_t solution;
+    size_t turn;
+    bool playing;
+    uint64_t asked; /* When the bot last had to answer */
+};
+
+/* Starts program with pipes to its stdin and stdout */
+static bool arena_spawn(struct ArenaProcess *p)
+{
+    int to[2];
+    int from[2];
+
+    if (pipe(to) == -1) {
+        perror("pipe");
+        return false;
+    }
+
+    if (pipe(from) == -1) {
+        perror("pipe");
+        close(to[0]);
+        close(to[1]);
+        return false;
+    }
+
+    /* Other bots must not inherit these, or they keep each other's pipes open */
+    for (int i = 0; i < 2; i++) {
+        fcntl(to[i], F_SETFD, FD_CLOEXEC);
+        fcntl(from[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+
+    p->pid = fork();
+
+    if (p->pid == 0) {
+        dup2(to[0], STDIN_FILENO);
+        dup2(from[1], STDOUT_FILENO);
+
+        execl("/bin/sh", "sh", "-c", p->bot->program, (char *)NULL);
+        perror(p->bot->program);
+        _exit(127);
+    }
+
+    close(to[0]);
+    close(from[1]);
+
+    if (p->pid == -1) {
+        perror("fork");
+        close(to[1]);
+        close(from[0]);
+        return false;
+    }
+
+    p->to = to[1];
+    p->from = from[0];
+    p->asked = monotonic_us();
+
+    return true;
+}
+
+/* Sends one line to the bot, false if it is not listening anymore */
+static bool arena_send(struct ArenaProcess *p, const char *line)
+{
+    size_t len = strlen(line);
+
+    while (len > 0) {
+        ssize_t n = write(p->to, line, len);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        line += n;
+        len -= n;
+    }
+
+    p->asked = monotonic_us();
+
+    return true;
+}
+
+/* Ends the bot's process. A game it was playing counts as lost. */
+static void arena_stop(struct ArenaProcess *p)
+{
+    if (p->playing) {
+        p->bot->games += 1;
+        p->bot->guesses += p->turn;
+        p->bot->failed += 1;
+        p->bot->crashed += 1;
+        p->playing = false;
+    }
+
+    if (p->to != -1)
+        close(p->to);
+    close(p->from);
+    p->to = -1;
+    p->from = -1;
+
+    kill(p->pid, SIGKILL);
+    waitpid(p->pid, NULL, 0);
+}
+
+/* Hands the bot its next game, or closes its stdin if there is none left */
+static void arena_next_game(struct ArenaProcess *p)
+{
+    if (p->bot->next_solution == solutions.len) {
+        close(p->to);
+        p->to = -1;
+        p->asked = monotonic_us(); /* The bot has until the timeout to exit */
+        return;
+    }
+
+    p->solution = p->bot->next_solution++;
+    p->turn = 0;
+    p->playing = true;
+
+    if (!arena_send(p, "new\n"))
+        arena_stop(p);
+}
+
+/* Referees one line the bot wrote */
+static void arena_line(struct ArenaProcess *p, const char *line)
+{
+    if (!p->playing)
+        return; /* Spoke out of turn */
+
+    struct ArenaBot *bot = p->bot;
+
+    bot->moves += 1;
+    bot->time_us += monotonic_us() - p->asked;
+    p->turn += 1;
+
+    char reply[BUF_SZ];
+    bool solved = false;
+
+    if (strlen(line) != LETTERS || !valid(line)) {
+        bot->invalid += 1;
+        strcpy(reply, "invalid\n");
+    } else {
+        format_feedback(score_word(line, solutions.array[p->solution].ptr), reply);
+        reply[LETTERS] = '\n';
+        reply[LETTERS + 1] = '\0';
+
+        solved = score_word(line, solutions.array[p->solution].ptr) == 0;
+    }
+
+    bool over = solved || p->turn == GUESSES;
+    if (over)
+        snprintf(reply, sizeof(reply), "over "SV_Fmt"\n", SV_Arg(solutions.array[p->solution]));
+
+    if (!arena_send(p, reply)) {
+        arena_stop(p);
+        return;
+    }
+
+    if (!over)
+        return;
+
+    bot->games += 1;
+    bot->guesses += p->turn;
+    if (!solved)
+        bot->failed += 1;
+
+    p->playing = false;
+    arena_next_game(p);
+}
+
+/* Reads what the bot wrote and referees every complete line */
+static void arena_read(struct ArenaProcess *p)
+{
+    ssize_t n = read(p->from, p->buf + p->buf_len, sizeof(p->buf) - 1 - p->buf_len);
+
+    if (n == -1 && errno == EINTR)
+        return;
+
+    if (n <= 0) {
+        arena_stop(p);
+        return;
+    }
+
+    p->buf_len += n;
+    p->buf[p->buf_len] = '\0';
+
+    char *line = p->buf;
+    char *newline;
+
+    while (p->from != -1 && (newline = strchr(line, '\n'))) {
+        *newline = '\0';
+        if (newline > line && newline[-1] == '\r')
+            newline[-1] = '\0';
+
+        arena_line(p, line);
+        line = newline + 1;
+    }
+
+    if (p->from == -1)
+        return;
+
+    p->buf_len -= line - p->buf;
+    memmove(p->buf, line, p->buf_len);
+
+    /* A line which does not fit can only be invalid */
+    if (p->buf_len == sizeof(p->buf) - 1) {
+        p->buf_len = 0;
+        arena_line(p, "");
+    }
+}
+
+/* Runs jobs copies of each program and has every one of them play every
+ * solution once, all at the same time from this one thread */
+static int arena(const char *const *programs, size_t programs_len, size_t jobs)
+{
+    struct ArenaBot *bots = calloc(programs_len, sizeof(*bots));
+    struct ArenaProcess *procs = calloc(programs_len * jobs, sizeof(*procs));
+    struct pollfd *fds = malloc(programs_len * jobs * sizeof(*fds));
+    size_t *polled = malloc(programs_len * jobs * sizeof(*polled));
+    size_t procs_len = 0;
+
+    /* A bot exiting early shows up as a failed write, not a signal */
+    struct sigaction ignore = { .sa_handler = SIG_IGN };
+    sigemptyset(&ignore.sa_mask);
+    sigaction(SIGPIPE, &ignore, NULL);
+
+    for (size_t b = 0; b < programs_len; b++) {
+        bots[b].program = programs[b];
+    }
+
+    /* One copy of every program after another, so running out of
+     * processes or descriptors leaves each with about as many */
+    for (size_t j = 0; j < jobs && procs_len == j * programs_len; j++) {
+        for (size_t b = 0; b < programs_len; b++) {
+            struct ArenaProcess *p = &procs[procs_len];
+            p->bot = &bots[b];
+
+            if (!arena_spawn(p)) {
+                fprintf(stderr, "Going on with the %zu bots started so far\n", procs_len);
+                break;
+            }
+
+            procs_len += 1;
+            arena_next_game(p);
+        }
+    }
+
+    for (;;) {
+        uint64_t now = monotonic_us();
+        uint64_t deadline = UINT64_MAX;
+        nfds_t nfds = 0;
+
+        for (size_t i = 0; i < procs_len; i++) {
+            struct ArenaProcess *p = &procs[i];
+
+            if (p->from == -1)
+                continue;
+
+            if (now - p->asked >= ARENA_TIMEOUT_MS * 1000) {
+                arena_stop(p);
+                continue;
+            }
+
+            if (p->asked + ARENA_TIMEOUT_MS * 1000 < deadline)
+                deadline = p->asked + ARENA_TIMEOUT_MS * 1000;
+
+            fds[nfds] = (struct pollfd){ .fd = p->from, .events = POLLIN };
+            polled[nfds++] = i;
+        }
+
+        if (nfds == 0)
+            break;
+
+        if (poll(fds, nfds, (deadline - now + 999) / 1000) == -1) {
+            if (errno == EINTR)
+                continue;
+            perror("poll");
+            exit(1);
+        }
+
+        for (nfds_t i = 0; i < nfds; i++) {
+            if (fds[i].revents)
+                arena_read(&procs[polled[i]]);
+        }
+    }
+
+    printf("%-24s %6s %8s %8s %8s %8s %10s\n", "program", "games", "average", "failed", "invalid", "crashed", "us/move");
+    for (size_t b = 0; b < programs_len; b++) {
+        const struct ArenaBot *bot = &bots[b];
+
+        printf("%-24s %6zu %8.4f %7.2f%% %8zu %8zu %10.1f\n", bot->program, bot->games,
+               bot->games ? (double)bot->guesses / bot->games : 0.0,
+               bot->games ? 100.0 * bot->failed / bot->games : 0.0,
+               bot->invalid, bot->crashed, bot->moves ? (double)bot->time_us / bot->moves : 0.0);
+    }
+
+    free(polled);
+    free(fds);
+    free(procs);
+    free(bots);
+
+    return 0;
+}
+
+/* A growable byte buffer */
+struct Buffer {
+    char *ptr;
+    size_t len;
+    size_t cap;
+};
+
+static void buffer_reserve(struct Buffer *b, size_t extra)
+{
+    if (b->len + extra <= b->cap)
+        return;
+
+    size_t cap = b->cap ? b->cap : BUF_SZ;
+    while (cap < b->len + extra) {
+        cap *= 2;
+    }
+
+    b->ptr = realloc(b->ptr, cap);
+    b->cap = cap;
+}
+
+static void buffer_append(struct Buffer *b, const char *data, size_t len)
+{
+    buffer_reserve(b, len);
+    memcpy(b->ptr + b->len, data, len);
+    b->len += len;
+}
+
+static void buffer_printf(struct Buffer *b, const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    int len = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+
+    buffer_reserve(b, len + 1);
+
+    va_start(args, fmt);
+    vsnprintf(b->ptr + b->len, len + 1, fmt, args);
+    va_end(args);
+
+    b->len += len;
+}
+
+/* Drops the first n bytes */
+static void buffer_consume(struct Buffer *b, size_t n)
+{
+    memmove(b->ptr, b->ptr + n, b->len - n);
+    b->len -= n;
+}
+
+static void buffer_free(struct Buffer *b)
+{
+    free(b->ptr);
+    *b = (struct Buffer){ 0 };
+}
+
+/* What one hint, validate or score request of the service asks for.
+ * Everything points into the request body. */
+struct ServiceRequest {
+    sv op; /* Only used in batches, otherwise the path says */
+    sv word;
+    sv guess;
+    sv solution;
+    sv game; /* Id of a game started with new */
+    sv bot; /* Plugin to ask for a hint instead of the solver */
+    sv guesses[GUESSES];
+    size_t guesses_len;
+    sv colors[GUESSES];
+    size_t colors_len;
+};
+
+static void json_skip_space(sv *in)
+{
+    while (in->len && (*in->ptr == ' ' || *in->ptr == '\t' || *in->ptr == '\r' || *in->ptr == '\n')) {
+        sv_chopl(1, in);
+    }
+}
+
+/* Consumes c (after any whitespace) if it comes next */
+static bool json_expect(sv *in, char c)
+{
+    json_skip_space(in);
+
+    if (!in->len || *in->ptr != c)
+        return false;
+
+    sv_chopl(1, in);
+
+    return true;
+}
+
+/* Reads a string. Escapes are left as they are: no word needs them. */
+static bool json_string(sv *in, sv *out)
+{
+    if (!json_expect(in, '"'))
+        return false;
+
+    for (size_t i = 0; i < in->len; i++) {
+        if (in->ptr[i] == '\\') {
+            i += 1;
+        } else if (in->ptr[i] == '"') {
+            *out = sv_substr(0, i, *in);
+            sv_chopl(i + 1, in);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Reads an array of at most max strings */
+static bool json_strings(sv *in, sv *out, size_t max, size_t *len)
+{
+    *len = 0;
+
+    if (!json_expect(in, '['))
+        return false;
+
+    if (json_expect(in, ']'))
+        return true;
+
+    do {
+        if (*len == max || !json_string(in, &out[(*len)++]))
+            return false;
+    } while (json_expect(in, ','));
+
+    return json_expect(in, ']');
+}
+
+/* Reads a request object. Only the fields of struct ServiceRequest are
+ * understood, and their values have to be strings or, for guesses and
+ * colors, arrays of strings. */
+static bool json_request(sv *in, struct ServiceRequest *req)
+{
+    *req = (struct ServiceRequest){ 0 };
+
+    if (!json_expect(in, '{'))
+        return false;
+
+    if (json_expect(in, '}'))
+        return true;
+
+    do {
+        sv key;
+        if (!json_string(in, &key) || !json_expect(in, ':'))
+            return false;
+
+        bool ok;
+        if (sv_cstr_eq(key, "guesses")) {
+            ok = json_strings(in, req->guesses, GUESSES, &req->guesses_len);
+        } else if (sv_cstr_eq(key, "colors")) {
+            ok = json_strings(in, req->colors, GUESSES, &req->colors_len);
+        } else {
+            sv value;
+            ok = json_string(in, &value);
+
+            if (!ok)
+                return false;
+
+            if (sv_cstr_eq(key, "op"))
+                req->op = value;
+            else if (sv_cstr_eq(key, "word"))
+                req->word = value;
+            else if (sv_cstr_eq(key, "guess"))
+                req->guess = value;
+            else if (sv_cstr_eq(key, "solution"))
+                req->solution = value;
+            else if (sv_cstr_eq(key, "game"))
+                req->game = value;
+            else if (sv_cstr_eq(key, "bot"))
+                req->bot = value;
+        }
+
+        if (!ok)
+            return false;
+    } while (json_expect(in, ','));
+
+    return json_expect(in, '}');
+}
+
+struct HttpConnection {
+    int fd;
+    struct ServiceShard *shard; /* The one serving it */
+    struct Buffer in;
+    struct Buffer out;
+    bool closing; /* Close once out is sent */
+};
+
+struct GameSlot {
+    struct Game game;
+    uint32_t generation; /* Bumped every time the slot gets a new game */
+    bool used;
+    time_t last_used;
+};
+
+/* One event loop of the service and the connections it owns. Nothing
+ * in here is shared with the other shards, so they need no locks,
+ * except for the games started here: a request for one of them can
+ * arrive on any shard. */
+struct ServiceShard {
+    pthread_t thread;
+    size_t index;
+    int sock;
+    struct HttpConnection **conns;
+    size_t conns_len;
+    size_t conns_cap;
+    struct pollfd *fds;
+
+    pthread_mutex_t games_lock;
+    struct GameSlot *games;
+    size_t games_len;
+    uint32_t *free_slots;
+    size_t free_len;
+    uint32_t seed; /* For choosing solutions */
+    bool accept_paused; /* Out of file descriptors */
+};
+
+static struct ServiceShard *service_shards;
+static size_t service_shards_len;
+
+/* Starts a game on shard and returns its id, or -1 if all slots are
+ * taken by games which were played recently. A game id holds the shard
+ * and slot of the game and the generation of the slot, so the id of a
+ * finished game does not find the next game in its slot. */
+static int64_t service_new_game(struct ServiceShard *shard)
+{
+    pthread_mutex_lock(&shard->games_lock);
+
+    time_t now = time(NULL);
+    size_t slot;
+
+    if (shard->free_len) {
+        slot = shard->free_slots[--shard->free_len];
+    } else if (shard->games_len < SERVICE_GAMES_MAX) {
+        if (shard->games_len % BUF_SZ == 0) {
+            size_t cap = shard->games_len + BUF_SZ;
+            shard->games = realloc(shard->games, cap * sizeof(*shard->games));
+            shard->free_slots = realloc(shard->free_slots, cap * sizeof(*shard->free_slots));
+        }
+
+        slot = shard->games_len++;
+        shard->games[slot].generation = 0;
+    } else {
+        /* Take over the game left alone the longest, if it was abandoned */
+        slot = 0;
+        for (size_t i = 1; i < shard->games_len; i++) {
+            if (shard->games[i].last_used < shard->games[slot].last_used)
+                slot = i;
+        }
+
+        if (now - shard->games[slot].last_used < SERVICE_GAME_IDLE_S) {
+            pthread_mutex_unlock(&shard->games_lock);
+            return -1;
+        }
+    }
+
+    struct GameSlot *s = &shard->games[slot];
+
+    s->generation = (s->generation + 1) & GAME_GENERATION_MASK;
+    s->used = true;
+    s->last_used = now;
+    game_init(&s->game, xorshift32(&shard->seed) % solutions.len);
+
+    int64_t id = (int64_t)s->generation << (GAME_SHARD_BITS + GAME_SLOT_BITS)
+        | shard->index << GAME_SLOT_BITS | slot;
+
+    pthread_mutex_unlock(&shard->games_lock);
+
+    return id;
+}
+
+/* Hands line to the game with the given id, wherever it lives. Copies
+ * the game as it is afterwards to out. Returns false if there is no
+ * such game. */
+static bool service_play(int64_t id, const char *line, enum GameEvent *event, struct Game *out)
+{
+    size_t index = (id >> GAME_SLOT_BITS) & ((1 << GAME_SHARD_BITS) - 1);
+    size_t slot = id & ((1 << GAME_SLOT_BITS) - 1);
+    uint32_t generation = id >> (GAME_SHARD_BITS + GAME_SLOT_BITS);
+
+    if (id < 0 || index >= service_shards_len)
+        return false;
+
+    struct ServiceShard *shard = &service_shards[index];
+    bool found = false;
+
+    pthread_mutex_lock(&shard->games_lock);
+
+    if (slot < shard->games_len && shard->games[slot].used && shard->games[slot].generation == generation) {
+        struct GameSlot *s = &shard->games[slot];
+
+        *event = game_input(&s->game, line);
+        *out = s->game;
+        s->last_used = time(NULL);
+
+        if (s->game.state != GamePlaying) {
+            s->used = false;
+            shard->free_slots[shard->free_len++] = slot;
+        }
+
+        found = true;
+    }
+
+    pthread_mutex_unlock(&shard->games_lock);
+
+    return found;
 }
 
-/* Called at exit. It is good practice to clean up after yourself. */
-static void cleanup(void)
+/* Appends the best guess for the candidates left in s */
+static void service_hint(struct Solver *s, struct Buffer *out)
 {
-    free(words.array);
+    long best = book_lookup(s, Entropy);
 
-    for (size_t i = 0; i < MMAPPED_FILES; i++) {
-        if (munmap(mmap_register[i].ptr, mmap_register[i].len) == -1) {
-            perror("munmap");
-        }
+    /* Only cuts the search short with many candidates left */
+    if (best == -1 && !hint_budget && !hint_sampled)
+        best = solver_best_within(s, Entropy, SERVICE_HINT_BUDGET_MS * 1000);
+    else if (best == -1)
+        best = solver_search(s, Entropy);
+
+    if (best == -1) {
+        buffer_printf(out, "{\"hint\":null,\"left\":0}");
+    } else {
+        buffer_printf(out, "{\"hint\":\""SV_Fmt"\",\"left\":%zu}", SV_Arg(words.array[best]), s->cand_len);
     }
 }
 
-int main(void)
+/* Like service_hint, but asks a plugin for the guess */
+static void service_plugin_hint(const struct Plugin *plugin, const struct Solver *s, const uint16_t *guesses,
+                                const uint8_t *patterns, struct Buffer *out)
 {
-    /* rand init */
-    srand(time(NULL));
+    struct clidle_bot_game state = {
+        .turn = s->turn,
+        .guesses = guesses,
+        .patterns = patterns,
+        .candidates = s->cand,
+        .candidates_len = s->cand_len,
+    };
 
-    /* Clidle init */
-    init_alphabet();
-    init_words();
-    choose_solution();
+    long best = -1;
+    plugin->bot->guess(&state, 1, &best);
 
-    atexit(cleanup);
+    if (best < 0 || (size_t)best >= words.len) {
+        buffer_printf(out, "{\"hint\":null,\"left\":%zu}", s->cand_len);
+    } else {
+        buffer_printf(out, "{\"hint\":\""SV_Fmt"\",\"left\":%zu}", SV_Arg(words.array[best]), s->cand_len);
+    }
+}
 
-    /* Readline init */
-    rl_editing_mode = 0; /* Put readline into vi-mode */
+/* Answers req as a JSON object appended to out. Returns false if
+ * the request itself was wrong, the object then holds the error. */
+static bool service_answer(struct ServiceShard *shard, sv op, const struct ServiceRequest *req, struct Buffer *out)
+{
+    if (sv_cstr_eq(op, "validate")) {
+        bool ok = index_lookup(&words_index, req->word.ptr, req->word.len) != -1;
+        buffer_printf(out, "{\"valid\":%s}", ok ? "true" : "false");
+        return true;
+    }
 
-    printf("\n\n");
+    if (sv_cstr_eq(op, "score")) {
+        long g = index_lookup(&words_index, req->guess.ptr, req->guess.len);
+        long answer = index_lookup(&words_index, req->solution.ptr, req->solution.len);
 
-    for (int i = 0; i < GUESSES; i++) {
-        reprint_alphabet();
+        if (g == -1 || answer == -1) {
+            buffer_printf(out, "{\"error\":\"%s is not in the word list\"}", g == -1 ? "guess" : "solution");
+            return false;
+        }
 
-        char *line = readline("");
+        char colors[LETTERS];
+        format_feedback(score_word(words.array[g].ptr, words.array[answer].ptr), colors);
+        buffer_printf(out, "{\"colors\":\"%.*s\"}", LETTERS, colors);
+        return true;
+    }
 
-        if (!line) {
-            return 0; /* EOF was typed, exit */
-        } else if (strlen(line) == 0) {
-            free(line);
-            i -= 1;
-            continue;
+    if (sv_cstr_eq(op, "hint")) {
+        if (req->guesses_len != req->colors_len) {
+            buffer_printf(out, "{\"error\":\"guesses and colors differ in length\"}");
+            return false;
         }
 
-        line[strcspn(line, "\n")] = '\0';
+        const struct Plugin *plugin = NULL;
+        if (req->bot.ptr) {
+            for (size_t i = 0; i < plugins_len && !plugin; i++) {
+                if (sv_cstr_eq(req->bot, plugins[i].name))
+                    plugin = &plugins[i];
+            }
+
+            if (!plugin) {
+                buffer_printf(out, "{\"error\":\"no such bot\"}");
+                return false;
+            }
+        }
+
+        struct Solver s;
+        solver_init(&s);
+        uint16_t guesses[GUESSES];
+        uint8_t patterns[GUESSES];
+
+        for (size_t i = 0; i < req->guesses_len; i++) {
+            long g = index_lookup(&words_index, req->guesses[i].ptr, req->guesses[i].len);
+            uint8_t pattern;
+
+            if (g == -1 || !parse_feedback(req->colors[i], &pattern)) {
+                buffer_printf(out, "{\"error\":\"%s %zu is invalid\"}", g == -1 ? "guess" : "colors", i + 1);
+                solver_free(&s);
+                return false;
+            }
+
+            solver_filter(&s, g, pattern);
+            guesses[i] = g;
+            patterns[i] = pattern;
+        }
+
+        if (plugin)
+            service_plugin_hint(plugin, &s, guesses, patterns, out);
+        else
+            service_hint(&s, out);
+
+        solver_free(&s);
+        return true;
+    }
+
+    if (sv_cstr_eq(op, "new")) {
+        int64_t id = service_new_game(shard);
+
+        if (id == -1) {
+            buffer_printf(out, "{\"error\":\"too many games\"}");
+            return false;
+        }
+
+        buffer_printf(out, "{\"game\":\"%lld\"}", (long long)id);
+        return true;
+    }
+
+    if (sv_cstr_eq(op, "guess")) {
+        char id_text[BUF_SZ];
+        char line[BUF_SZ];
+        char *end;
 
-        if (strlen(line) != LETTERS) {
-            misinput("Wrong length");
-            i -= 1; /* Misinput does not count as guess */
-        } else if (!valid(line)) {
-            misinput("Not in word list");
-            i -= 1; /* Misinput does not count as guess */
+        sv_to_cstr(req->game, id_text, sizeof(id_text));
+        sv_to_cstr(req->guess, line, sizeof(line));
+
+        long long id = strtoll(id_text, &end, 10);
+        enum GameEvent event;
+        struct Game game;
+
+        if (!*id_text || *end || !service_play(id, line, &event, &game)) {
+            buffer_printf(out, "{\"error\":\"no such game\"}");
+            return false;
+        }
+
+        switch (event) {
+            case GameIgnored:
+            case GameWrongLength:
+                buffer_printf(out, "{\"error\":\"wrong length\"}");
+                return false;
+            case GameUnknownWord:
+                buffer_printf(out, "{\"error\":\"not in word list\"}");
+                return false;
+            case GameHintAsked: {
+                struct Solver s;
+                solver_init(&s);
+                game_filter(&game, &s);
+                service_hint(&s, out);
+                solver_free(&s);
+                return true;
+            }
+            case GameGuessed:
+            case GameOver:
+                break;
+        }
+
+        char colors[LETTERS];
+        format_feedback(game.patterns[game.turn - 1], colors);
+
+        if (game.state == GamePlaying) {
+            buffer_printf(out, "{\"colors\":\"%.*s\",\"state\":\"playing\"}", LETTERS, colors);
         } else {
-            color_word_and_update_alphabet(line);
+            buffer_printf(out, "{\"colors\":\"%.*s\",\"state\":\"%s\",\"solution\":\""SV_Fmt"\"}", LETTERS, colors,
+                          game.state == GameWon ? "won" : "lost", SV_Arg(solutions.array[game.solution]));
+        }
+        return true;
+    }
+
+    buffer_printf(out, "{\"error\":\"unknown op\"}");
+    return false;
+}
+
+/* Answers a request for path with the given body. Returns the HTTP status. */
+static int service_route(struct ServiceShard *shard, sv method, sv path, sv body, struct Buffer *out)
+{
+    if (!sv_cstr_eq(path, "/hint") && !sv_cstr_eq(path, "/validate") && !sv_cstr_eq(path, "/score")
+        && !sv_cstr_eq(path, "/new") && !sv_cstr_eq(path, "/guess") && !sv_cstr_eq(path, "/batch")) {
+        buffer_printf(out, "{\"error\":\"not found\"}");
+        return 404;
+    }
+
+    if (!sv_cstr_eq(method, "POST")) {
+        buffer_printf(out, "{\"error\":\"use POST\"}");
+        return 405;
+    }
+
+    struct ServiceRequest req;
+
+    if (!sv_cstr_eq(path, "/batch")) {
+        /* An empty body, as for new, stands for an empty object */
+        json_skip_space(&body);
+        if (!body.len)
+            body = SV_Lit("{}");
+
+        if (!json_request(&body, &req) || (json_skip_space(&body), body.len)) {
+            buffer_printf(out, "{\"error\":\"malformed request\"}");
+            return 400;
+        }
+
+        sv_chopl(1, &path);
+        return service_answer(shard, path, &req, out) ? 200 : 400;
+    }
+
+    /* A batch is an array of requests, answered by an array of results.
+     * A malformed element fails the whole batch before anything is done. */
+    sv check = body;
+    size_t count = 0;
+    bool ok = json_expect(&check, '[');
+
+    if (ok && !json_expect(&check, ']')) {
+        do {
+            ok = json_request(&check, &req);
+            count += 1;
+        } while (ok && json_expect(&check, ','));
+
+        ok = ok && json_expect(&check, ']');
+    }
+
+    json_skip_space(&check);
+    if (!ok || check.len) {
+        buffer_printf(out, "{\"error\":\"malformed request %zu\"}", count);
+        return 400;
+    }
+
+    json_expect(&body, '[');
+    buffer_append(out, "[", 1);
+
+    for (size_t i = 0; i < count; i++) {
+        if (i > 0) {
+            json_expect(&body, ',');
+            buffer_append(out, ",", 1);
+        }
+
+        json_request(&body, &req);
+        service_answer(shard, req.op, &req, out);
+    }
+
+    buffer_append(out, "]", 1);
+
+    return 200;
+}
+
+static const char *http_reason(int status)
+{
+    switch (status) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 413: return "Payload Too Large";
+        case 431: return "Request Header Fields Too Large";
+        default: return "Error";
+    }
+}
+
+static void http_respond(struct HttpConnection *c, int status, const struct Buffer *body, bool keep_alive)
+{
+    buffer_printf(&c->out,
+                  "HTTP/1.1 %d %s\r\n"
+                  "Content-Type: application/json\r\n"
+                  "Content-Length: %zu\r\n"
+                  "%s"
+                  "\r\n",
+                  status, http_reason(status), body->len, keep_alive ? "" : "Connection: close\r\n");
+    buffer_append(&c->out, body->ptr, body->len);
+
+    if (!keep_alive)
+        c->closing = true;
+}
+
+/* Answers with an error and gives up on the connection */
+static void http_fail(struct HttpConnection *c, int status)
+{
+    struct Buffer body = { 0 };
+
+    buffer_printf(&body, "{\"error\":\"%s\"}", http_reason(status));
+    http_respond(c, status, &body, false);
+    buffer_free(&body);
+}
+
+static bool header_name_eq(sv name, const char *cstr)
+{
+    if (name.len != strlen(cstr))
+        return false;
+
+    for (size_t i = 0; i < name.len; i++) {
+        if (tolower((unsigned char)name.ptr[i]) != cstr[i])
+            return false;
+    }
+
+    return true;
+}
+
+/* Answers every complete request that has arrived on c so far */
+static void http_process(struct HttpConnection *c)
+{
+    while (!c->closing && c->in.len) {
+        sv in = sv_from_data(c->in.ptr, c->in.len);
+
+        size_t head_len = sv_idx_long(SV_Lit("\r\n\r\n"), in);
+        if (head_len == SV_END_POS) {
+            if (c->in.len > HTTP_HEAD_MAX)
+                http_fail(c, 431);
+            return;
+        }
+
+        sv head = sv_substr(0, head_len, in);
+        sv line, method, path, version;
+
+        sv_chop_delim('\n', &head, &line);
+        if (line.len && line.ptr[line.len - 1] == '\r')
+            sv_chopr(1, &line);
 
-            if (check_correct(line)) {
-                free(line);
-                return 0;
+        if (!sv_chop_delim(' ', &line, &method) || !sv_chop_delim(' ', &line, &path)
+            || !sv_chop_delim(' ', &line, &version) || !sv_starts_with(SV_Lit("HTTP/1."), version)) {
+            http_fail(c, 400);
+            return;
+        }
+
+        /* HTTP/1.1 keeps the connection open by default, 1.0 does not */
+        bool keep_alive = sv_cstr_eq(version, "HTTP/1.1");
+        size_t body_len = 0;
+
+        sv header;
+        while (sv_chop_delim('\n', &head, &header)) {
+            if (header.len && header.ptr[header.len - 1] == '\r')
+                sv_chopr(1, &header);
+
+            sv name;
+            sv_chop_delim(':', &header, &name);
+            json_skip_space(&header);
+
+            if (header_name_eq(name, "content-length")) {
+                char value[BUF_SZ];
+                body_len = strtoul(sv_to_cstr(header, value, sizeof(value)), NULL, 10);
+            } else if (header_name_eq(name, "connection")) {
+                if (header_name_eq(header, "close"))
+                    keep_alive = false;
+                else if (header_name_eq(header, "keep-alive"))
+                    keep_alive = true;
             }
+        }
+
+        if (body_len > HTTP_BODY_MAX) {
+            http_fail(c, 413);
+            return;
+        }
 
-            /* Clear the now current line that has the alphabet on it */
-            printf(VT100_ERASE);
+        size_t total = head_len + 4 + body_len;
+        if (c->in.len < total)
+            return; /* The body is still on its way */
 
-            y += 1;
+        struct Buffer body = { 0 };
+        int status = service_route(c->shard, method, path, sv_substr(head_len + 4, body_len, in), &body);
+
+        http_respond(c, status, &body, keep_alive);
+        buffer_free(&body);
+
+        buffer_consume(&c->in, total);
+    }
+}
+
+/* Reads what arrived on c. Returns false if the client went away. */
+static bool http_read(struct HttpConnection *c)
+{
+    for (;;) {
+        buffer_reserve(&c->in, BUF_SZ * 32);
+
+        ssize_t n = read(c->fd, c->in.ptr + c->in.len, c->in.cap - c->in.len);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
         }
 
-        free(line);
+        if (n == 0)
+            return false;
+
+        c->in.len += n;
+
+        if (c->in.len > HTTP_HEAD_MAX + HTTP_BODY_MAX)
+            return true; /* Let http_process turn it down */
+    }
+}
+
+/* Sends as much of c's output as the socket takes. Returns false on errors. */
+static bool http_write(struct HttpConnection *c)
+{
+    while (c->out.len) {
+        ssize_t n = send(c->fd, c->out.ptr, c->out.len, MSG_NOSIGNAL);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+
+        buffer_consume(&c->out, n);
+    }
+
+    return true;
+}
+
+static void set_nonblocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL);
+
+    if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+        perror("fcntl");
+        exit(1);
+    }
+}
+
+/* Listens on port of the loopback address only */
+static int service_listen(const char *port_text)
+{
+    long port = atol(port_text);
+    if (port < 1 || port > 65535) {
+        fprintf(stderr, "%s: Invalid port\n", port_text);
+        exit(1);
+    }
+
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock == -1) {
+        perror("socket");
+        exit(1);
+    }
+
+    int on = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) == -1 || listen(sock, SOMAXCONN) == -1) {
+        perror(port_text);
+        exit(1);
+    }
+
+    set_nonblocking(sock);
+
+    return sock;
+}
+
+static void *service_shard(void *arg)
+{
+    struct ServiceShard *shard = arg;
+
+    for (;;) {
+        shard->fds = realloc(shard->fds, (shard->conns_len + 1) * sizeof(*shard->fds));
+        shard->fds[0] = (struct pollfd){ .fd = shard->sock, .events = shard->accept_paused ? 0 : POLLIN };
+
+        for (size_t i = 0; i < shard->conns_len; i++) {
+            struct HttpConnection *c = shard->conns[i];
+            short events = 0;
+
+            /* Stop reading from clients which do not read their answers */
+            if (!c->closing && c->out.len < HTTP_BODY_MAX)
+                events |= POLLIN;
+            if (c->out.len)
+                events |= POLLOUT;
+
+            shard->fds[i + 1] = (struct pollfd){ .fd = c->fd, .events = events };
+        }
+
+        int ready = poll(shard->fds, shard->conns_len + 1, shard->accept_paused ? ACCEPT_BACKOFF_MS : -1);
+        if (ready == -1) {
+            if (errno == EINTR)
+                continue;
+            perror("poll");
+            exit(1);
+        }
+
+        if (ready == 0)
+            shard->accept_paused = false;
+
+        /* Go backwards so that removing a connection does not skip one */
+        for (size_t i = shard->conns_len; i-- > 0;) {
+            struct HttpConnection *c = shard->conns[i];
+            short revents = shard->fds[i + 1].revents;
+            bool alive = true;
+
+            if (revents & (POLLIN | POLLHUP | POLLERR)) {
+                alive = http_read(c);
+                http_process(c);
+            }
+
+            if (alive)
+                alive = http_write(c);
+
+            if (alive && c->closing && !c->out.len)
+                alive = false;
+
+            if (!alive) {
+                close(c->fd);
+                buffer_free(&c->in);
+                buffer_free(&c->out);
+                free(c);
+                shard->conns[i] = shard->conns[--shard->conns_len];
+                shard->accept_paused = false;
+            }
+        }
+
+        /* Every shard waits on the listening socket and whichever gets
+         * there first owns the connection. Taking only one per wakeup
+         * leaves the rest of a burst to the other shards. */
+        if (shard->fds[0].revents & POLLIN) {
+            int fd = accept(shard->sock, NULL, NULL);
+            if (fd == -1) {
+                /* Until a descriptor is free the waiting connection would wake us up again and again */
+                if (errno == EMFILE || errno == ENFILE)
+                    shard->accept_paused = true;
+                continue; /* Otherwise another shard was faster */
+            }
+
+            set_nonblocking(fd);
+
+            if (shard->conns_len == shard->conns_cap) {
+                shard->conns_cap = shard->conns_cap ? shard->conns_cap * 2 : 16;
+                shard->conns = realloc(shard->conns, shard->conns_cap * sizeof(*shard->conns));
+            }
+
+            struct HttpConnection *c = calloc(1, sizeof(*c));
+            c->fd = fd;
+            c->shard = shard;
+            shard->conns[shard->conns_len++] = c;
+        }
+    }
+
+    return NULL;
+}
+
+/* Answers hint, validate and score requests as JSON over HTTP on
+ * localhost, see the README. Connections are spread over jobs threads,
+ * each of which serves its own with poll. Only the word lists, indices
+ * and the book are shared, and those are never written. */
+static int service(const char *port, size_t jobs)
+{
+    static struct Book computed;
+
+    int sock = service_listen(port);
+
+    /* Hints for the first two turns would need the full matrix */
+    if (!book) {
+        fprintf(stderr, "No opening book, computing it first (see make book)\n");
+        compute_book(&computed);
+        book = &computed;
+    }
+
+    /* Game ids only have room for so many shards */
+    if (jobs > 1 << GAME_SHARD_BITS)
+        jobs = 1 << GAME_SHARD_BITS;
+
+    struct ServiceShard *shards = calloc(jobs, sizeof(*shards));
+    service_shards = shards;
+    service_shards_len = jobs;
+
+    for (size_t i = 0; i < jobs; i++) {
+        shards[i].index = i;
+        shards[i].sock = sock;
+        shards[i].seed = time(NULL) ^ (i + 1) * 0x9e3779b9u;
+        pthread_mutex_init(&shards[i].games_lock, NULL);
+
+        if (pthread_create(&shards[i].thread, NULL, service_shard, &shards[i]) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
     }
 
-    printf("The word was: "SV_Fmt"\n", SV_Arg(solution));
+    for (size_t i = 0; i < jobs; i++) {
+        pthread_join(shards[i].thread, NULL);
+    }
 
     return 0;
 }
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-b | -s | -a | -g [-j JOBS] | -T [-j JOBS] [-P PLUGIN]... | -A PROGRAM... [-j JOBS] | -r FILE [-c [-j JOBS]] | -Z SOCKET | -C SOCKET | -H PORT [-j JOBS] [-P PLUGIN]...] [-d MS] [-D MS | -M] [-R] [-t FILE]\n", prog);
+    fprintf(stderr, "  -b       Build the opening book (" BOOK_FILE ") and exit\n");
+    fprintf(stderr, "  -s       Show statistics and exit\n");
+    fprintf(stderr, "  -a       Help with a game played elsewhere, reading lines like \"crane gybxx\"\n");
+    fprintf(stderr, "  -g       Print a table rating every word as a first guess and exit\n");
+    fprintf(stderr, "  -T       Play every strategy against every solution and compare them\n");
+    fprintf(stderr, "  -P FILE  Load a strategy for -T or -H from a shared library (see clidle_bot.h)\n");
+    fprintf(stderr, "  -A PROG  Have the bot program PROG play every solution, talking over pipes\n");
+    fprintf(stderr, "  -r FILE  Replay the recorded games in FILE\n");
+    fprintf(stderr, "  -c       Only check that the replayed games are valid\n");
+    fprintf(stderr, "  -j JOBS  Threads for -c, -g, -T and -H, copies of each -A bot (default: CPUs)\n");
+    fprintf(stderr, "  -d MS    Delay between revealed letters (default 250, 0 for none)\n");
+    fprintf(stderr, "  -D MS    Time limit for computing a hint (default: none)\n");
+    fprintf(stderr, "  -M       Estimate hints on a sample of the candidates first\n");
+    fprintf(stderr, "  -Z SOCK  Load everything once and fork a game for every client on SOCK\n");
+    fprintf(stderr, "  -C SOCK  Play a game served by the zygote on SOCK on this terminal\n");
+    fprintf(stderr, "  -H PORT  Answer hint, validate and score requests over HTTP on localhost\n");
+    fprintf(stderr, "  -R       Read guesses key by key instead of using readline\n");
+    fprintf(stderr, "  -t FILE  Write a trace of every turn's phases to FILE (Chrome trace format)\n");
+}
+
+int main(int argc, char **argv)
+{
+    bool opt_build_book = false;
+    bool opt_stats = false;
+    bool opt_check = false;
+    bool opt_assistant = false;
+    bool opt_report = false;
+    bool opt_tournament = false;
+    const char *opt_replay = NULL;
+    const char *opt_zygote = NULL;
+    const char *opt_client = NULL;
+    const char *opt_service = NULL;
+    const char *opt_arena[ARENA_PROGRAMS_MAX];
+    size_t opt_arena_len = 0;
+    long opt_jobs = sysconf(_SC_NPROCESSORS_ONLN);
+
+    int opt;
+    while ((opt = getopt(argc, argv, "bsagTP:A:H:r:cj:d:D:MZ:C:Rt:")) != -1) {
+        switch (opt) {
+            case 'b':
+                opt_build_book = true;
+                break;
+            case 's':
+                opt_stats = true;
+                break;
+            case 'a':
+                opt_assistant = true;
+                break;
+            case 'g':
+                opt_report = true;
+                break;
+            case 'T':
+                opt_tournament = true;
+                break;
+            case 'P':
+                load_plugin(optarg);
+                break;
+            case 'H':
+                opt_service = optarg;
+                break;
+            case 'A':
+                if (opt_arena_len == ARENA_PROGRAMS_MAX) {
+                    fprintf(stderr, "At most %d programs can play in the arena\n", ARENA_PROGRAMS_MAX);
+                    return 1;
+                }
+                opt_arena[opt_arena_len++] = optarg;
+                break;
+            case 'r':
+                opt_replay = optarg;
+                break;
+            case 'c':
+                opt_check = true;
+                break;
+            case 'j':
+                opt_jobs = atol(optarg);
+                if (opt_jobs < 1) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'd': {
+                long ms = atol(optarg);
+                if (ms < 0) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                reveal_delay = (struct timespec){ ms / 1000, ms % 1000 * 1000000 };
+                break;
+            }
+            case 'D': {
+                long ms = atol(optarg);
+                if (ms < 0) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                hint_budget = (uint64_t)ms * 1000;
+                break;
+            }
+            case 'M':
+                hint_sampled = true;
+                break;
+            case 'Z':
+                opt_zygote = optarg;
+                break;
+            case 'C':
+                opt_client = optarg;
+                break;
+            case 'R':
+                raw_input = true;
+                break;
+            case 't':
+                trace_path = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (opt_stats) {
+        print_stats();
+        return 0;
+    }
+
+    if (opt_client)
+        return zygote_client(opt_client);
+
+    /* rand init */
+    srand(time(NULL));
+
+    /* Clidle init */
+    uint64_t phase = trace_begin();
+
+    init_alphabet();
+    init_solutions();
+    choose_solution();
+    solver_init(&solver);
+    start_loading_words();
+
+    trace_end("load", phase);
+
+    atexit(cleanup);
+
+    if (opt_build_book) {
+        words_wait();
+        build_book();
+        return 0;
+    }
+
+    if (opt_assistant)
+        return assistant();
+
+    if (opt_report) {
+        words_wait();
+        return report_first_guesses(opt_jobs > 0 ? opt_jobs : 1);
+    }
+
+    if (opt_tournament) {
+        words_wait();
+        return tournament(opt_jobs > 0 ? opt_jobs : 1);
+    }
+
+    if (opt_arena_len) {
+        words_wait();
+        return arena(opt_arena, opt_arena_len, opt_jobs > 0 ? opt_jobs : 1);
+    }
+
+    if (opt_replay) {
+        words_wait();
+        return replay_file(opt_replay, opt_check, opt_jobs > 0 ? opt_jobs : 1);
+    }
+
+    if (opt_zygote)
+        return zygote(opt_zygote);
+
+    if (opt_service) {
+        words_wait();
+        init_plugins();
+        return service(opt_service, opt_jobs > 0 ? opt_jobs : 1);
+    }
+
+    return play();
+}
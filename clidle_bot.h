@@ -0,0 +1,62 @@
+/* Interface for solving strategies built as shared libraries and loaded
+ * into clidle with -P, e.g. `clidle -T -P ./bot.so`.
+ *
+ * A plugin exports one `const struct clidle_bot clidle_bot`. Words are
+ * referred to by their index into the word lists passed to init; they
+ * are CLIDLE_BOT_LETTERS lowercase letters and not NUL terminated.
+ *
+ * Feedback on a guess is a pattern: one base 3 digit per letter, the
+ * first letter least significant, with 0 for the right place, 1 for the
+ * wrong place and 2 for a letter not in the solution. A solved game has
+ * pattern 0.
+ *
+ * Repeated letters follow clidle's rule rather than Wordle's: a letter
+ * off its place is in the wrong place whenever the solution has it at
+ * a position the guess got wrong, however often the guess repeats it. */
+#ifndef CLIDLE_BOT_H
+#define CLIDLE_BOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Bumped whenever the structs or calls below change */
+#define CLIDLE_BOT_ABI 1
+
+#define CLIDLE_BOT_LETTERS 5
+
+struct clidle_bot_words {
+    const char *const *words; /* Every allowed guess */
+    size_t words_len;
+    const char *const *solutions; /* Every possible solution */
+    size_t solutions_len;
+};
+
+/* One game in progress */
+struct clidle_bot_game {
+    size_t turn; /* Number of guesses made so far */
+    const uint16_t *guesses; /* turn indices into words */
+    const uint8_t *patterns; /* The feedback on each guess */
+
+    /* Indices into solutions of the ones still possible, as a courtesy */
+    const uint16_t *candidates;
+    size_t candidates_len;
+};
+
+struct clidle_bot {
+    int abi; /* CLIDLE_BOT_ABI */
+    const char *name;
+
+    /* Called once before any game, may be NULL. The word lists stay
+     * valid until fini. Returns 0 on success. */
+    int (*init)(const struct clidle_bot_words *words);
+
+    /* Picks the next guess for each of the n games: an index into
+     * words, or -1 to give up. Called with many games at once and
+     * from several threads at once, each with its own games. */
+    void (*guess)(const struct clidle_bot_game *games, size_t n, long *guesses);
+
+    /* Called once after the last game, may be NULL */
+    void (*fini)(void);
+};
+
+#endif /* CLIDLE_BOT_H */